@@ -14,278 +14,2403 @@
 #include <algorithm>
 #include <functional>
 #include <random>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <bitset>
+#include <limits>
+#include <memory>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ctime>
 
 //! Elevator complete requests while moving in requested direction, that fact make it efficient and logical.
 
+//! Log of elevator events, long simulations turn it off
+bool logEnabled = true;
+
+std::ostream& elevatorLog()
+{
+    static std::ostream disabledLog(nullptr);
+    return logEnabled ? std::cout : disabledLog;
+}
+
+//! Source of time in seconds, injected into event queue so the same elevator runs in simulated time
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+    virtual double now() const = 0;
+    //! called before event of given time is run
+    virtual void advanceTo(double time) = 0;
+};
+
+//! Simulated time jumps straight to the next event, a day of traffic takes milliseconds
+class SimulatedClock : public Clock
+{
+public:
+    double now() const override { return currentTime; }
+    void advanceTo(double time) override { currentTime = std::max(currentTime, time); }
+
+private:
+    double currentTime = 0.0;
+};
+
+//! Wall time from construction, scale above one runs faster than real time. Event queue on this clock
+//! sleeps until the time of the next event instead of spinning
+class RealTimeClock : public Clock
+{
+public:
+    explicit RealTimeClock(double timeScale = 1.0)
+    : timeScale(timeScale)
+    , start(std::chrono::steady_clock::now())
+    {
+    }
+
+    double now() const override
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * timeScale;
+    }
+
+    void advanceTo(double time) override
+    {
+        std::this_thread::sleep_until(toTimePoint(time));
+    }
+
+    std::chrono::steady_clock::time_point toTimePoint(double time) const
+    {
+        return start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time / timeScale));
+    }
+
+private:
+    double timeScale;
+    std::chrono::steady_clock::time_point start;
+};
+
+//! Discrete-event queue on table of event slots, events run in order of time and events of the same time
+//! in order of scheduling. Event is plain callback with context, so scheduling does not allocate while the table
+//! has free slots. Handle keeps generation of its slot, handle of event that already ran or was cancelled is stale
+//! and ignored, even when the slot holds other event now
+class EventQueue
+{
+public:
+    using Callback = void (*)(void* context, int argument);
+
+    struct Handle
+    {
+        int slot = -1;
+        uint32_t generation = 0;
+    };
+
+    //! table grows only when more than capacity events are scheduled at once
+    explicit EventQueue(Clock* clock, size_t capacity = 1024)
+    : clock(clock)
+    {
+        slots.reserve(capacity);
+        freeSlots.reserve(capacity);
+        order.reserve(capacity);
+    }
+
+    double now() const { return clock->now(); }
+    bool empty() const { return order.empty(); }
+    double nextTime() const { return slots[order.front()].time; }
+
+    Handle schedule(double time, Callback callback, void* context, int argument = 0)
+    {
+        int slot;
+        if(freeSlots.empty())
+        {
+            slot = static_cast<int>(slots.size());
+            slots.emplace_back();
+        }
+        else
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+
+        auto& event = slots[slot];
+        event.time = time;
+        event.sequence = nextSequence++;
+        event.callback = callback;
+        event.context = context;
+        event.argument = argument;
+        order.push_back(slot);
+        siftUp(order.size() - 1);
+        return Handle {slot, event.generation};
+    }
+
+    //! returns false for stale handle
+    bool cancel(Handle handle)
+    {
+        if(!isPending(handle))
+            return false;
+        removeAt(static_cast<size_t>(slots[handle.slot].heapIndex));
+        return true;
+    }
+
+    bool isPending(Handle handle) const
+    {
+        return handle.slot >= 0 && static_cast<size_t>(handle.slot) < slots.size()
+            && slots[handle.slot].generation == handle.generation && slots[handle.slot].heapIndex >= 0;
+    }
+
+    //! runs the earliest event, returns false if there are no events
+    bool runNext()
+    {
+        if(order.empty())
+            return false;
+
+        // slot is free before callback runs, so callback can schedule into it
+        const auto event = slots[order.front()];
+        removeAt(0);
+        clock->advanceTo(event.time);
+        event.callback(event.context, event.argument);
+        return true;
+    }
+
+    //! runs all events up to the time and moves clock to it
+    void runUntil(double time)
+    {
+        while(!order.empty() && nextTime() <= time)
+            runNext();
+        clock->advanceTo(time);
+    }
+
+private:
+    struct Slot
+    {
+        double time = 0.0;
+        uint64_t sequence = 0;
+        Callback callback = nullptr;
+        void* context = nullptr;
+        int argument = 0;
+        //! changes every time slot is freed
+        uint32_t generation = 0;
+        //! position in order heap, -1 for free slot
+        int heapIndex = -1;
+    };
+
+    bool isEarlier(int left, int right) const
+    {
+        const auto& leftSlot = slots[left];
+        const auto& rightSlot = slots[right];
+        return leftSlot.time < rightSlot.time || (leftSlot.time == rightSlot.time && leftSlot.sequence < rightSlot.sequence);
+    }
+
+    void place(size_t index, int slot)
+    {
+        order[index] = slot;
+        slots[slot].heapIndex = static_cast<int>(index);
+    }
+
+    void siftUp(size_t index)
+    {
+        auto slot = order[index];
+        while(index > 0 && isEarlier(slot, order[(index - 1) / 2]))
+        {
+            place(index, order[(index - 1) / 2]);
+            index = (index - 1) / 2;
+        }
+        place(index, slot);
+    }
+
+    void siftDown(size_t index)
+    {
+        auto slot = order[index];
+        while(true)
+        {
+            auto child = 2 * index + 1;
+            if(child >= order.size())
+                break;
+            if(child + 1 < order.size() && isEarlier(order[child + 1], order[child]))
+                child++;
+            if(!isEarlier(order[child], slot))
+                break;
+            place(index, order[child]);
+            index = child;
+        }
+        place(index, slot);
+    }
+
+    void removeAt(size_t index)
+    {
+        auto slot = order[index];
+        auto last = order.back();
+        order.pop_back();
+        if(index < order.size())
+        {
+            place(index, last);
+            siftUp(index);
+            siftDown(static_cast<size_t>(slots[last].heapIndex));
+        }
+        slots[slot].heapIndex = -1;
+        slots[slot].generation++;
+        freeSlots.push_back(slot);
+    }
+
+    Clock* clock;
+    std::vector<Slot> slots;
+    std::vector<int> freeSlots;
+    //! binary heap of slots, the earliest event on top
+    std::vector<int> order;
+    uint64_t nextSequence = 0;
+};
+
+//! Limits of car motion and door timing, distances in meters
+struct MotionLimits
+{
+    double floorHeight = 3.5;
+    double maxSpeed = 2.5;
+    double acceleration = 1.0;
+    double jerk = 1.6;
+    double doorOpenSeconds = 2.0;
+    //! doors stay open for passengers
+    double dwellSeconds = 3.0;
+    double doorCloseSeconds = 3.0;
+};
+
+//! Rest to rest trip limited by jerk, acceleration and speed (S-curve): jerk raises acceleration, car accelerates,
+//! jerk takes acceleration back to zero at peak speed, cruises and brakes symmetrically. Short trip does not reach
+//! max speed or even max acceleration. Everything in closed form, distances in floors, so travel time of any trip
+//! costs a few arithmetic operations
+class Kinematics
+{
+public:
+    struct Trip
+    {
+        double distance = 0.0;
+        double peakSpeed = 0.0;
+        double peakAcceleration = 0.0;
+        //! time of jerk from zero to peak acceleration
+        double jerkTime = 0.0;
+        //! time of constant acceleration
+        double constantTime = 0.0;
+        //! time from rest to peak speed
+        double rampTime = 0.0;
+        double duration = 0.0;
+        //! since this time trip differs from longer trips, car can not be sent farther
+        double commitTime = 0.0;
+    };
+
+    explicit Kinematics(const MotionLimits& limits = MotionLimits())
+    : limits(limits)
+    , maxSpeed(limits.maxSpeed / limits.floorHeight)
+    , jerk(limits.jerk / limits.floorHeight)
+    // acceleration is not reached if jerk takes car to max speed before it
+    , acceleration(std::min(limits.acceleration / limits.floorHeight, std::sqrt(maxSpeed * jerk)))
+    , fullRampTime(maxSpeed / acceleration + acceleration / jerk)
+    {
+    }
+
+    Trip plan(double distance) const
+    {
+        Trip trip;
+        trip.distance = distance;
+        if(distance <= 0.0)
+            return trip;
+        if(distance >= maxSpeed * fullRampTime)
+        {
+            trip.peakSpeed = maxSpeed;
+            trip.peakAcceleration = acceleration;
+        }
+        else if(distance >= 2.0 * acceleration * acceleration * acceleration / (jerk * jerk))
+        {
+            // ramp of speed v covers v * (v / a + a / j) both ways, root of the quadratic
+            auto term = acceleration * acceleration / jerk;
+            trip.peakSpeed = (-term + std::sqrt(term * term + 4.0 * acceleration * distance)) / 2.0;
+            trip.peakAcceleration = acceleration;
+        }
+        else
+        {
+            trip.peakAcceleration = jerk * std::cbrt(distance / (2.0 * jerk));
+            trip.peakSpeed = trip.peakAcceleration * trip.peakAcceleration / jerk;
+        }
+        trip.jerkTime = trip.peakAcceleration / jerk;
+        trip.constantTime = std::max(0.0, trip.peakSpeed / trip.peakAcceleration - trip.jerkTime);
+        trip.rampTime = 2.0 * trip.jerkTime + trip.constantTime;
+        auto cruiseTime = std::max(0.0, distance / trip.peakSpeed - trip.rampTime);
+        trip.duration = 2.0 * trip.rampTime + cruiseTime;
+        // trips of max speed differ when braking starts, slower trips when acceleration starts to fall
+        trip.commitTime = trip.peakSpeed >= maxSpeed ? trip.rampTime + cruiseTime : trip.jerkTime + trip.constantTime;
+        return trip;
+    }
+
+    double travelTime(double distance) const { return plan(distance).duration; }
+
+    //! distance from start of trip at time, braking half mirrors ramp
+    double position(const Trip& trip, double time) const
+    {
+        if(time <= 0.0)
+            return 0.0;
+        if(time >= trip.duration)
+            return trip.distance;
+        if(time > trip.duration / 2.0)
+            return trip.distance - position(trip, trip.duration - time);
+        if(time > trip.rampTime)
+            return rampDistance(trip, trip.rampTime) + trip.peakSpeed * (time - trip.rampTime);
+        return rampDistance(trip, time);
+    }
+
+    //! the shortest trip that is still the same motion as trip started time ago, car can stop only that far
+    double stopDistance(double time) const
+    {
+        if(time <= 0.0)
+            return 0.0;
+        if(time <= acceleration / jerk)
+            return 2.0 * jerk * time * time * time;
+        if(time <= maxSpeed / acceleration)
+        {
+            auto speed = acceleration * time;
+            return speed * (speed / acceleration + acceleration / jerk);
+        }
+        return maxSpeed * std::max(time, fullRampTime);
+    }
+
+    //! doors open, passengers enter and doors close
+    double getDoorCycleSeconds() const { return limits.doorOpenSeconds + limits.dwellSeconds + limits.doorCloseSeconds; }
+    const MotionLimits& getLimits() const { return limits; }
+
+private:
+    static double rampDistance(const Trip& trip, double time)
+    {
+        auto jerk = trip.peakAcceleration / std::max(trip.jerkTime, 1e-9);
+        auto jerkTime = trip.jerkTime;
+        if(time <= jerkTime)
+            return jerk * time * time * time / 6.0;
+        auto speed = jerk * jerkTime * jerkTime / 2.0;
+        auto distance = jerk * jerkTime * jerkTime * jerkTime / 6.0;
+        auto constantTime = std::min(time - jerkTime, trip.constantTime);
+        distance += speed * constantTime + trip.peakAcceleration * constantTime * constantTime / 2.0;
+        speed += trip.peakAcceleration * constantTime;
+        auto fallTime = time - jerkTime - constantTime;
+        return distance + speed * fallTime + trip.peakAcceleration * fallTime * fallTime / 2.0 - jerk * fallTime * fallTime * fallTime / 6.0;
+    }
+
+    MotionLimits limits;
+    //! floors per second, per second squared and cubed
+    double maxSpeed;
+    double jerk;
+    double acceleration;
+    double fullRampTime;
+};
+
+//! Motor does not poll time, goToFloor plans the trip in closed form and schedules event for every floor on the way,
+//! the last one when doors are open. Doors close after dwell, the next trip starts then.
+//! Moving car can be sent to another floor only while trip to it is still the same motion
 class ElevatorMotor
 {
 public:
-    ElevatorMotor()
+    explicit ElevatorMotor(EventQueue* events, const Kinematics& kinematics = Kinematics())
+    : events(events)
+    , kinematics(kinematics)
+    {
+    }
+    enum Direction { Up = 1, None = 0, Down = -1 };
+    int getCurrentFloor() { return static_cast<int>(std::round(getPosition())); }
+    Direction getCurrentDirection() { return currentDirection; }
+    //! position between floors at current time
+    float getPosition()
+    {
+        if(currentDirection == Direction::None)
+            return startPosition;
+        auto distance = kinematics.position(trip, events->now() - departureTime);
+        return startPosition + static_cast<float>(distance) * static_cast<float>(currentDirection);
+    }
+    //! car waits on floor or closes doors before trip
+    bool isStopped() { return currentDirection == Direction::None || events->now() <= departureTime; }
+    //! car can stop on every floor strictly ahead of this position in its direction
+    float getBrakingPosition()
+    {
+        if(isStopped())
+            return startPosition;
+        auto elapsed = events->now() - departureTime;
+        auto distance = elapsed <= trip.commitTime ? kinematics.stopDistance(elapsed) : trip.distance;
+        return startPosition + (static_cast<float>(distance) - 0.001f) * static_cast<float>(currentDirection);
+    }
+    const Kinematics& getKinematics() const { return kinematics; }
+
+    //! moving car goes to floor only if it can stop there, returns false otherwise.
+    //! Waiting car starts when doors are closed
+    bool goToFloor(int floor)
+    {
+        if((currentDirection == Direction::None && floor == getCurrentFloor()) || (currentDirection != Direction::None && floor == destinationFloor))
+            return true;
+
+        auto now = events->now();
+        if(currentDirection != Direction::None && now > departureTime)
+        {
+            auto distance = (static_cast<float>(floor) - startPosition) * static_cast<float>(currentDirection);
+            // longer and shorter trips are the same motion only until the shorter one commits
+            if(distance <= 0.0f || now - departureTime > kinematics.plan(std::min(static_cast<double>(distance), trip.distance)).commitTime)
+                return false;
+        }
+        else
+        {
+            startPosition = getPosition();
+            events->cancel(nextFloorEvent);
+            // trip that did not start yet is cancelled
+            if(floor == getCurrentFloor())
+            {
+                currentDirection = Direction::None;
+                return true;
+            }
+            departureTime = std::max(now, doorsClosedTime);
+            currentDirection = floor < startPosition ? Direction::Down : Direction::Up;
+        }
+
+        elevatorLog()<<"Go to floor "<<floor<<std::endl;
+        destinationFloor = floor;
+        trip = kinematics.plan(std::abs(static_cast<double>(floor) - startPosition));
+        // floor of the previous trip is not passed anymore
+        events->cancel(nextFloorEvent);
+        scheduleNextFloor();
+        return true;
+    }
+
+    //! passengers enter stopped car, closed doors open again and trip waits for them
+    void holdDoors()
+    {
+        const auto& limits = kinematics.getLimits();
+        auto now = events->now();
+        auto doorsOpen = now < doorsClosedTime - limits.doorCloseSeconds;
+        doorsClosedTime = std::max(doorsClosedTime, now + (doorsOpen ? 0.0 : limits.doorOpenSeconds) + limits.dwellSeconds + limits.doorCloseSeconds);
+        if(currentDirection != Direction::None && departureTime < doorsClosedTime)
+        {
+            departureTime = doorsClosedTime;
+            events->cancel(nextFloorEvent);
+            scheduleNextFloor();
+        }
+    }
+
+    //! called with floor that moving car passes without stop
+    void subscribeFloorPassed(const std::function<void(int)>& callBack)
+    {
+        onFloorPassed = callBack;
+    }
+
+    //! called with floor where car stopped at the end of goToFloor and opened doors
+    void subscribeArrived(const std::function<void(int)>& callBack)
+    {
+        onArrived = callBack;
+    }
+
+private:
+    void scheduleNextFloor()
+    {
+        const float epsilon = 0.001f;
+        auto position = getPosition();
+        auto nextFloor = currentDirection == Direction::Up
+            ? static_cast<int>(std::floor(position + epsilon)) + 1
+            : static_cast<int>(std::ceil(position - epsilon)) - 1;
+        // late event of wall clock finds car farther than the floor, it never goes past destination
+        if((nextFloor - destinationFloor) * static_cast<int>(currentDirection) > 0)
+            nextFloor = destinationFloor;
+        double time;
+        if(nextFloor == destinationFloor)
+            time = departureTime + trip.duration + kinematics.getLimits().doorOpenSeconds;
+        else
+        {
+            // position grows with time, bisection finds when floor is passed
+            auto distance = (static_cast<double>(nextFloor) - startPosition) * static_cast<double>(currentDirection);
+            double low = std::max(0.0, events->now() - departureTime);
+            double high = trip.duration;
+            for(int iteration = 0; iteration < 40; ++iteration)
+            {
+                auto middle = (low + high) / 2.0;
+                (kinematics.position(trip, middle) < distance ? low : high) = middle;
+            }
+            time = departureTime + high;
+        }
+        nextFloorEvent = events->schedule(time, &ElevatorMotor::onFloorEvent, this, nextFloor);
+    }
+
+    static void onFloorEvent(void* motor, int floor)
+    {
+        static_cast<ElevatorMotor*>(motor)->passFloor(floor);
+    }
+
+    void passFloor(int floor)
+    {
+        if(floor == destinationFloor)
+        {
+            currentDirection = Direction::None;
+            startPosition = static_cast<float>(floor);
+            const auto& limits = kinematics.getLimits();
+            doorsClosedTime = events->now() + limits.dwellSeconds + limits.doorCloseSeconds;
+            elevatorLog()<<"stop moving on the floor "<<floor<<"\n";
+            if(onArrived)
+                onArrived(floor);
+        }
+        else
+        {
+            scheduleNextFloor();
+            if(onFloorPassed)
+                onFloorPassed(floor);
+        }
+    }
+
+    EventQueue* events;
+    Kinematics kinematics;
+    Direction currentDirection = None;
+    //! floor where trip started, or where car waits
+    float startPosition = 0.0f;
+    int destinationFloor = 0;
+    Kinematics::Trip trip;
+    //! trip starts when doors are closed
+    double departureTime = 0.0;
+    double doorsClosedTime = 0.0;
+    EventQueue::Handle nextFloorEvent;
+    std::function<void(int)> onFloorPassed;
+    std::function<void(int)> onArrived;
+};
+
+class ElevatorControllerBase
+{
+    // called when an up or down button was pushed on a floor
+    virtual void summonButtonPushed(int summoningFloor, ElevatorMotor::Direction direction) = 0;
+
+    // called when a button for a floor is pushed inside the car
+    virtual void floorButtonPushed(int destinationFloor) = 0;
+
+    // called when the car has reached a particular floor
+    virtual void reachedFloor(int floor) = 0;
+};
+
+//! index of the lowest set bit, mask is not zero
+inline int lowestSetBit(uint64_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#else
+    int index = 0;
+    while((mask & 1) == 0)
+    {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+//! index of the highest set bit, mask is not zero
+inline int highestSetBit(uint64_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(mask);
+#else
+    int index = 63;
+    while((mask & (uint64_t(1) << index)) == 0)
+        index--;
+    return index;
+#endif
+}
+
+//! Set of floors for building of any height: bits in 64 bit words and summary word with bit of every
+//! non-empty word, so search of the next floor in any direction checks at most three words
+class FloorSet
+{
+public:
+    static constexpr int maxFloorCount = 64 * 64;
+
+    explicit FloorSet(int floorCount = 0)
+    : words(static_cast<size_t>((floorCount + 63) / 64), 0)
+    {
+        assert(floorCount <= maxFloorCount);
+    }
+
+    bool test(int floor) const { return (words[floor >> 6] & bit(floor & 63)) != 0; }
+    bool empty() const { return summary == 0; }
+
+    void set(int floor)
+    {
+        words[floor >> 6] |= bit(floor & 63);
+        summary |= bit(floor >> 6);
+    }
+
+    void reset(int floor)
+    {
+        auto& word = words[floor >> 6];
+        word &= ~bit(floor & 63);
+        if(word == 0)
+            summary &= ~bit(floor >> 6);
+    }
+
+    //! the lowest floor of set not lower than floor, -1 if there is none
+    int findNext(int floor) const
+    {
+        floor = std::max(floor, 0);
+        auto index = floor >> 6;
+        if(index >= static_cast<int>(words.size()))
+            return -1;
+        auto word = words[index] & (~uint64_t(0) << (floor & 63));
+        if(word != 0)
+            return index * 64 + lowestSetBit(word);
+        auto rest = index == 63 ? 0 : summary & (~uint64_t(0) << (index + 1));
+        if(rest == 0)
+            return -1;
+        index = lowestSetBit(rest);
+        return index * 64 + lowestSetBit(words[index]);
+    }
+
+    //! the highest floor of set not higher than floor, -1 if there is none
+    int findPrevious(int floor) const
+    {
+        if(floor < 0 || words.empty())
+            return -1;
+        floor = std::min(floor, static_cast<int>(words.size()) * 64 - 1);
+        auto index = floor >> 6;
+        auto word = words[index] & (~uint64_t(0) >> (63 - (floor & 63)));
+        if(word != 0)
+            return index * 64 + highestSetBit(word);
+        auto rest = summary & (bit(index) - 1);
+        if(rest == 0)
+            return -1;
+        index = highestSetBit(rest);
+        return index * 64 + highestSetBit(words[index]);
+    }
+
+private:
+    static uint64_t bit(int index) { return uint64_t(1) << index; }
+
+    std::vector<uint64_t> words;
+    uint64_t summary = 0;
+};
+
+inline ElevatorMotor::Direction getOppositeDirection(ElevatorMotor::Direction direction)
+{
+    if(direction == ElevatorMotor::Direction::Down)
+        return ElevatorMotor::Direction::Up;
+    if(direction == ElevatorMotor::Direction::Up)
+        return ElevatorMotor::Direction::Down;
+    return direction;
+}
+
+//! Origins of hall calls by hour of day and zone of floors. Every call adds a little more than the previous one,
+//! so old days fade out without decay of the whole table, and the table is scaled back before numbers grow too
+//! big. Size does not depend on count of calls, tall building is split into zones of neighbour floors
+class CallHistogram
+{
+public:
+    static constexpr int slotCount = 24;
+    static constexpr double slotSeconds = 3600.0;
+    static constexpr int maxZoneCount = 64;
+
+    //! weight of call halves after this many newer calls of the same hour
+    explicit CallHistogram(int floorCount, double halfLifeCalls = 500.0)
+    : floorCount(floorCount)
+    , zoneCount(std::min(floorCount, maxZoneCount))
+    , growth(std::pow(2.0, 1.0 / halfLifeCalls))
+    , weights(static_cast<size_t>(slotCount * zoneCount), 0.0)
+    , increments(slotCount, 1.0)
+    {
+    }
+
+    void record(int floor, double time)
+    {
+        auto slot = getSlot(time);
+        auto row = &weights[static_cast<size_t>(slot * zoneCount)];
+        row[getZone(floor)] += increments[slot];
+        increments[slot] *= growth;
+        if(increments[slot] > 1e100)
+        {
+            for(int zone = 0; zone < zoneCount; ++zone)
+                row[zone] /= increments[slot];
+            increments[slot] = 1.0;
+        }
+    }
+
+    static int getSlot(double time)
+    {
+        return static_cast<int>(std::fmod(time, slotCount * slotSeconds) / slotSeconds) % slotCount;
+    }
+
+    int getZoneCount() const { return zoneCount; }
+    int getZone(int floor) const { return floor * zoneCount / floorCount; }
+    //! the middle floor of zone
+    int getZoneFloor(int zone) const
+    {
+        auto first = (zone * floorCount + zoneCount - 1) / zoneCount;
+        auto last = ((zone + 1) * floorCount + zoneCount - 1) / zoneCount - 1;
+        return (first + last) / 2;
+    }
+    //! relative weights, only shares of zones in the slot have meaning
+    const double* getWeights(int slot) const { return &weights[static_cast<size_t>(slot * zoneCount)]; }
+
+private:
+    int floorCount;
+    int zoneCount;
+    double growth;
+    std::vector<double> weights;
+    std::vector<double> increments;
+};
+
+//! Idle car waits on the floor where the next call of this hour is expected to be reached the fastest,
+//! learned from origins of hall calls. Other idle cars already cover their floors, so group spreads out
+class ParkingPlanner
+{
+public:
+    //! car moves to better floor only if it saves more than this on expected response
+    static constexpr double minimumGainSeconds = 2.0;
+
+    ParkingPlanner(EventQueue* events, int floorCount, const Kinematics& kinematics = Kinematics())
+    : events(events)
+    , kinematics(kinematics)
+    , histogram(floorCount)
+    {
+    }
+
+    void recordCall(int floor) { histogram.record(floor, events->now()); }
+    int getSlot() const { return CallHistogram::getSlot(events->now()); }
+
+    //! floor for car waiting on current floor, other floors are where other idle cars wait
+    int chooseParkingFloor(int currentFloor, const std::vector<int>& otherFloors) const
+    {
+        auto slot = getSlot();
+        auto bestFloor = currentFloor;
+        auto bestSeconds = expectedSeconds(slot, currentFloor, otherFloors) - minimumGainSeconds;
+        for(int zone = 0; zone < histogram.getZoneCount(); ++zone)
+        {
+            auto floor = histogram.getZoneFloor(zone);
+            auto seconds = expectedSeconds(slot, floor, otherFloors);
+            if(seconds < bestSeconds)
+            {
+                bestSeconds = seconds;
+                bestFloor = floor;
+            }
+        }
+        return bestFloor;
+    }
+
+private:
+    //! average time to reach origin of call from the nearest idle car, zero without history
+    double expectedSeconds(int slot, int floor, const std::vector<int>& otherFloors) const
+    {
+        auto weights = histogram.getWeights(slot);
+        double weightSum = 0.0;
+        double seconds = 0.0;
+        for(int zone = 0; zone < histogram.getZoneCount(); ++zone)
+        {
+            if(weights[zone] == 0.0)
+                continue;
+            auto origin = histogram.getZoneFloor(zone);
+            auto distance = std::abs(origin - floor);
+            for(auto other : otherFloors)
+                distance = std::min(distance, std::abs(origin - other));
+            seconds += weights[zone] * kinematics.travelTime(distance);
+            weightSum += weights[zone];
+        }
+        return weightSum > 0.0 ? seconds / weightSum : 0.0;
+    }
+
+    EventQueue* events;
+    Kinematics kinematics;
+    CallHistogram histogram;
+};
+
+//! car loaded to this share of capacity bypasses hall calls, it stops only for passengers inside
+constexpr double bypassLoadShare = 0.8;
+
+//! the next stop of sweep (LOOK) ahead of position: the nearest car call or hall call of direction,
+//! otherwise the farthest hall call of opposite direction where car turns, -1 if nothing is ahead
+inline int findStopAhead(const FloorSet& carCalls, const FloorSet& upCalls, const FloorSet& downCalls, int floorCount,
+                         float position, ElevatorMotor::Direction direction)
+{
+    if(direction == ElevatorMotor::Direction::Up)
+    {
+        auto first = static_cast<int>(std::floor(position)) + 1;
+        auto carStop = carCalls.findNext(first);
+        auto hallStop = upCalls.findNext(first);
+        if(carStop != -1 || hallStop != -1)
+            return carStop == -1 ? hallStop : (hallStop == -1 ? carStop : std::min(carStop, hallStop));
+        auto turn = downCalls.findPrevious(floorCount - 1);
+        return turn >= first ? turn : -1;
+    }
+    if(direction == ElevatorMotor::Direction::Down)
+    {
+        auto last = static_cast<int>(std::ceil(position)) - 1;
+        auto stop = std::max(carCalls.findPrevious(last), downCalls.findPrevious(last));
+        if(stop != -1)
+            return stop;
+        auto turn = upCalls.findNext(0);
+        return turn != -1 && turn <= last ? turn : -1;
+    }
+    return -1;
+}
+
+//! Calls are sets of floors: hall calls up, hall calls down and calls from inside of car.
+//! Car serves them in sweeps (LOOK): it stops on car calls and calls of its direction ahead,
+//! turns back on the farthest call of opposite direction when nothing else is ahead.
+//! Floor count is set at runtime, cost of every button and every stop does not depend on it
+class ElevatorController : public ElevatorControllerBase
+{
+public:
+    //! capacity in passengers
+    ElevatorController(ElevatorMotor* motor, int floorCount, int capacity = 13)
+    : motor(motor)
+    , floorCount(floorCount)
+    , capacity(capacity)
+    , upCalls(floorCount)
+    , downCalls(floorCount)
+    , carCalls(floorCount)
+    , noCalls(floorCount)
+    {
+        assert(floorCount > 1 && floorCount <= FloorSet::maxFloorCount);
+        motor->subscribeArrived([this] (int floor) { reachedFloor(floor); });
+    }
+
+    // called when an up or down button was pushed on a floor
+    void summonButtonPushed(int summoningFloor, ElevatorMotor::Direction direction) override
+    {
+        elevatorLog()<<"Summon btn pushed floor - "<<summoningFloor<<" direction - "<<direction<<std::endl;
+        getHallCalls(direction).set(summoningFloor);
+        if(parking != nullptr)
+            parking->recordCall(summoningFloor);
+    }
+
+    // called when a button for a floor is pushed inside the car
+    void floorButtonPushed(int destinationFloor) override
+    {
+        elevatorLog()<<"Floor btn pushed floor - "<<destinationFloor<<std::endl;
+
+        if(motor->getCurrentDirection() == ElevatorMotor::Direction::None && destinationFloor == motor->getCurrentFloor())
+            return;
+        carCalls.set(destinationFloor);
+    }
+
+    // called when the car has stopped on a floor
+    void reachedFloor(int floor) override
+    {
+        elevatorLog()<<"Reached floor - "<<floor<<std::endl;
+        target = -1;
+        parkedSlot = -1;
+        carCalls.reset(floor);
+
+        // car turns back on the floor if there is nothing more ahead
+        if(sweep == ElevatorMotor::Direction::None || findStopAhead(static_cast<float>(floor), sweep) == -1)
+        {
+            auto opposite = getOppositeDirection(sweep);
+            sweep = findStopAhead(static_cast<float>(floor), opposite) != -1 ? opposite : ElevatorMotor::Direction::None;
+        }
+
+        // waiting car takes passengers of both directions, full car stopped for its passenger keeps hall call
+        // of the floor, the car comes back for it when it has room
+        if(!isBypassing())
+        {
+            if(sweep == ElevatorMotor::Direction::None)
+            {
+                upCalls.reset(floor);
+                downCalls.reset(floor);
+            }
+            else
+                getHallCalls(sweep).reset(floor);
+        }
+
+        elevatorLog()<<"Complete move to requested floor "<<floor<<std::endl;
+        if(onFloorServed)
+            onFloorServed(floor, sweep);
+        if(onRequestCompleted)
+            onRequestCompleted();
+    }
+
+    //! called after every event of simulation and button push
+    void work()
+    {
+        if(motor->isStopped())
+        {
+            auto floor = motor->getCurrentFloor();
+            // call on the floor where car waits is served at once, arrivals come from motor.
+            // Car that closes doors before trip opens them only for its direction
+            auto waiting = motor->getCurrentDirection() == ElevatorMotor::Direction::None;
+            if(carCalls.test(floor)
+                || (!isBypassing() && (waiting ? upCalls.test(floor) || downCalls.test(floor) : getHallCalls(sweep).test(floor))))
+            {
+                motor->holdDoors();
+                reachedFloor(floor);
+            }
+        }
+
+        auto nextTarget = findTarget();
+        if(nextTarget == -1)
+            park();
+        if(nextTarget == -1 || nextTarget == target)
+            return;
+        auto waiting = motor->getCurrentDirection() == ElevatorMotor::Direction::None;
+        // moving car can not stop on floor it is too close to
+        if(!motor->goToFloor(nextTarget))
+            return;
+        target = nextTarget;
+        // waiting car starts new sweep toward target, moving car keeps its sweep
+        if(waiting)
+            sweep = target < motor->getPosition() ? ElevatorMotor::Direction::Down : ElevatorMotor::Direction::Up;
+    }
+
+    void subscribeRequestCompleted(const std::function<void()>& callBack)
+    {
+        onRequestCompleted = callBack;
+    }
+
+    //! called with floor and direction of passengers that car takes there, None for both directions
+    void subscribeFloorServed(const std::function<void(int, ElevatorMotor::Direction)>& callBack)
+    {
+        onFloorServed = callBack;
+    }
+
+    int getFloorCount() const { return floorCount; }
+
+    //! passengers in car from load sensor
+    void setLoad(int passengers) { load = passengers; }
+
+    //! without planner car waits where it stopped
+    void setParkingPlanner(ParkingPlanner* planner) { parking = planner; }
+
+private:
+    //! car without calls goes to parking floor, decided again after every stop and when hour changes
+    void park()
+    {
+        if(parking == nullptr || motor->getCurrentDirection() != ElevatorMotor::Direction::None || parkedSlot == parking->getSlot())
+            return;
+        parkedSlot = parking->getSlot();
+        auto floor = parking->chooseParkingFloor(motor->getCurrentFloor(), {});
+        if(floor == motor->getCurrentFloor() || !motor->goToFloor(floor))
+            return;
+        elevatorLog()<<"Parking on floor - "<<floor<<std::endl;
+        target = floor;
+        sweep = target < motor->getPosition() ? ElevatorMotor::Direction::Down : ElevatorMotor::Direction::Up;
+    }
+
+    FloorSet& getHallCalls(ElevatorMotor::Direction direction)
+    {
+        return direction == ElevatorMotor::Direction::Down ? downCalls : upCalls;
+    }
+
+    bool isBypassing() const { return load >= bypassLoadShare * capacity; }
+
+    //! full car passes hall calls, they wait until passengers leave
+    int findStopAhead(float position, ElevatorMotor::Direction direction) const
+    {
+        if(isBypassing())
+            return ::findStopAhead(carCalls, noCalls, noCalls, floorCount, position, direction);
+        return ::findStopAhead(carCalls, upCalls, downCalls, floorCount, position, direction);
+    }
+
+    //! the next stop in sweep direction, waiting car looks in opposite direction too, -1 if there are no calls
+    int findTarget() const
+    {
+        auto position = motor->getBrakingPosition();
+        auto direction = sweep == ElevatorMotor::Direction::None ? ElevatorMotor::Direction::Up : sweep;
+        auto stop = findStopAhead(position, direction);
+        if(stop != -1)
+            return stop;
+        // moving car can not turn back before it stops
+        if(motor->getCurrentDirection() != ElevatorMotor::Direction::None)
+            return target;
+        stop = findStopAhead(position, getOppositeDirection(direction));
+        return stop != -1 ? stop : target;
+    }
+
+    ElevatorMotor* motor;
+    int floorCount;
+    int capacity;
+    int load = 0;
+    FloorSet upCalls;
+    FloorSet downCalls;
+    FloorSet carCalls;
+    //! always empty, hall calls of bypassing car
+    FloorSet noCalls;
+    //! direction of sweep, stays when car stops on the way
+    ElevatorMotor::Direction sweep = ElevatorMotor::Direction::None;
+    //! floor where car goes now, -1 if it waits
+    int target = -1;
+    ParkingPlanner* parking = nullptr;
+    //! hour of the last parking decision, -1 after stop
+    int parkedSlot = -1;
+    std::function<void()> onRequestCompleted;
+    std::function<void(int, ElevatorMotor::Direction)> onFloorServed;
+};
+
+//! Group of cars, every hall call assigned to the car that would arrive to it first, estimation includes
+//! stops already committed to the car. Calls are assigned again on every event, so when other car becomes
+//! clearly faster the call goes to it. Every car serves own stops in sweeps (LOOK): it goes in its direction
+//! while there are stops ahead and turns back only after the last of them.
+//! Stops are floor sets, so estimation jumps from stop to stop and does not walk over every floor.
+//! In destination dispatch passengers enter destination on the floor and get the car at once: the car
+//! which arrives first counting stops the trip adds, so passengers to the same floor go together
+class ElevatorGroupController : public ElevatorControllerBase
+{
+    //! passenger of destination dispatch who waits for assigned car
+    struct DestinationCall
+    {
+        int origin;
+        int destination;
+        ElevatorMotor::Direction direction;
+    };
+
+    struct Car
+    {
+        explicit Car(ElevatorMotor* motor, int floorCount)
+        : motor(motor)
+        , carCalls(floorCount)
+        , assignedUp(floorCount)
+        , assignedDown(floorCount)
+        , arrivalUp(static_cast<size_t>(floorCount))
+        , arrivalDown(static_cast<size_t>(floorCount))
+        {
+        }
+
+        ElevatorMotor* motor;
+        //! direction of sweep, stays when car stops on the way
+        ElevatorMotor::Direction sweep = ElevatorMotor::Direction::None;
+        //! floor where car goes now, -1 if it waits
+        int target = -1;
+        //! passengers inside
+        int load = 0;
+        //! hour of the last parking decision, -1 after stop
+        int parkedSlot = -1;
+        FloorSet carCalls;
+        //! hall calls and destination calls assigned to the car
+        FloorSet assignedUp;
+        FloorSet assignedDown;
+        //! destination calls of passengers not in car yet, car sets their car calls when they board
+        std::vector<DestinationCall> pickups;
+        //! estimated seconds until car stops for call of every floor, kept to avoid allocation
+        std::vector<double> arrivalUp;
+        std::vector<double> arrivalDown;
+    };
+
+    static constexpr int noCar = -1;
+    //! call moves to other car only if that car is faster by this time, so calls do not jump between cars
+    static constexpr double reassignSeconds = 10.0;
+    //! arrival of floor not estimated yet
+    static constexpr double unknownArrival = -1.0;
+
+public:
+    //! capacity of every car in passengers
+    ElevatorGroupController(const std::vector<ElevatorMotor*>& motors, int floorCount, int carCapacity = 13)
+    : floorCount(floorCount)
+    , carCapacity(carCapacity)
+    , upCalls(static_cast<size_t>(floorCount), noCar)
+    , downCalls(static_cast<size_t>(floorCount), noCar)
+    , upCallFloors(floorCount)
+    , downCallFloors(floorCount)
+    , noCalls(floorCount)
+    {
+        assert(floorCount > 1 && floorCount <= FloorSet::maxFloorCount && !motors.empty());
+        for(auto motor : motors)
+        {
+            auto index = static_cast<int>(cars.size());
+            cars.emplace_back(motor, floorCount);
+            motor->subscribeArrived([this, index] (int floor)
+            {
+                activeCar = index;
+                reachedFloor(floor);
+            });
+        }
+    }
+
+    // called when an up or down button was pushed on a floor
+    void summonButtonPushed(int summoningFloor, ElevatorMotor::Direction direction) override
+    {
+        elevatorLog()<<"Summon btn pushed floor - "<<summoningFloor<<" direction - "<<direction<<std::endl;
+        // pushed again when passengers were left by full car, calls may go to other cars
+        plansChanged = true;
+
+        if(getHallCalls(direction)[summoningFloor] == noCar)
+        {
+            estimateArrivals();
+            assignHallCall(summoningFloor, direction, findBestCar(summoningFloor, direction, noCar));
+        }
+        if(parking != nullptr)
+            parking->recordCall(summoningFloor);
+    }
+
+    //! destination dispatch, called when passenger entered destination on the floor, returns car for the passenger.
+    //! Assignment is fixed, passenger goes to the door of the car
+    int destinationCallPushed(int originFloor, int destinationFloor)
+    {
+        assert(originFloor != destinationFloor);
+        auto direction = destinationFloor > originFloor ? ElevatorMotor::Direction::Up : ElevatorMotor::Direction::Down;
+        plansChanged = true;
+        int bestCar = 0;
+        double bestCost = std::numeric_limits<double>::max();
+        // passengers inside and those still coming take places, the rest of cars wait for free car
+        auto hasPlace = [&] (const Car& car) { return car.load + static_cast<int>(car.pickups.size()) < carCapacity; };
+        auto anyPlace = std::any_of(cars.begin(), cars.end(), hasPlace);
+        estimateArrivals();
+        for(int index = 0; index < static_cast<int>(cars.size()); ++index)
+        {
+            auto& car = cars[index];
+            if(anyPlace && !hasPlace(car))
+                continue;
+            // every new stop costs door time, trips to floors where the car stops anyway come for free
+            int addedStops = getAssigned(car, direction).test(originFloor) ? 0 : 1;
+            if(!car.carCalls.test(destinationFloor) && !hasPlannedStop(index, destinationFloor))
+                addedStops++;
+            auto cost = getArrival(index, originFloor, direction)
+                + car.motor->getKinematics().getDoorCycleSeconds() * addedStops;
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                bestCar = index;
+            }
+        }
+
+        if(parking != nullptr)
+            parking->recordCall(originFloor);
+        elevatorLog()<<"Destination call floor - "<<originFloor<<" to floor - "<<destinationFloor<<" assigned car "<<bestCar<<std::endl;
+        cars[bestCar].pickups.push_back(DestinationCall {originFloor, destinationFloor, direction});
+        getAssigned(cars[bestCar], direction).set(originFloor);
+        return bestCar;
+    }
+
+    // called when a button for a floor is pushed inside the car, the car which stopped the last
+    void floorButtonPushed(int destinationFloor) override
+    {
+        floorButtonPushed(activeCar, destinationFloor);
+    }
+
+    void floorButtonPushed(int carIndex, int destinationFloor)
+    {
+        elevatorLog()<<"Floor btn pushed in car "<<carIndex<<" floor - "<<destinationFloor<<std::endl;
+        auto& car = cars[carIndex];
+        if(car.motor->getCurrentDirection() == ElevatorMotor::Direction::None && destinationFloor == car.motor->getCurrentFloor())
+            return;
+        car.carCalls.set(destinationFloor);
+        plansChanged = true;
+    }
+
+    // called when the car has reached a particular floor, the car which stopped the last
+    void reachedFloor(int floor) override
+    {
+        elevatorLog()<<"Car "<<activeCar<<" reached floor - "<<floor<<std::endl;
+        auto& car = cars[activeCar];
+        car.target = -1;
+        car.parkedSlot = -1;
+        plansChanged = true;
+        if(onCarStopped)
+            onCarStopped(activeCar, floor);
+        if(car.carCalls.test(floor))
+        {
+            car.carCalls.reset(floor);
+            if(onRequestCompleted)
+                onRequestCompleted(activeCar, floor);
+        }
+
+        // car turns back on the floor if there is nothing more ahead, waiting car goes where its passengers go
+        auto hasWork = [&] (ElevatorMotor::Direction direction)
+        {
+            return findStopAhead(activeCar, static_cast<float>(floor), direction) != -1 || hasPickups(activeCar, floor, direction);
+        };
+        if(car.sweep == ElevatorMotor::Direction::None)
+        {
+            if(hasPickups(activeCar, floor, ElevatorMotor::Direction::Up))
+                car.sweep = ElevatorMotor::Direction::Up;
+            else if(hasPickups(activeCar, floor, ElevatorMotor::Direction::Down))
+                car.sweep = ElevatorMotor::Direction::Down;
+        }
+        else if(!hasWork(car.sweep))
+            car.sweep = hasWork(getOppositeDirection(car.sweep)) ? getOppositeDirection(car.sweep) : ElevatorMotor::Direction::None;
+
+        // full car stopped for its passenger keeps hall calls and passengers of destination calls on the floor
+        for(auto direction : {ElevatorMotor::Direction::Up, ElevatorMotor::Direction::Down})
+        {
+            if(isBypassing(activeCar) || (car.sweep != ElevatorMotor::Direction::None && car.sweep != direction))
+                continue;
+            auto boarded = boardDestinationCalls(floor, direction);
+            if(!serveHallCall(floor, direction) && boarded && onHallCallServed)
+                onHallCallServed(activeCar, floor, direction);
+        }
+    }
+
+    //! called after every event of simulation and button push, hall calls are estimated again only after events
+    //! that change plans of cars, car passing a floor does not
+    void work()
+    {
+        if(plansChanged)
+        {
+            plansChanged = false;
+            reassignHallCalls();
+        }
+        for(int index = 0; index < static_cast<int>(cars.size()); ++index)
+        {
+            activeCar = index;
+            auto& car = cars[index];
+            auto motor = car.motor;
+            if(motor->isStopped())
+            {
+                auto floor = motor->getCurrentFloor();
+                // call on the floor where car waits is served at once, arrivals come from motor.
+                // Car that closes doors before trip opens them only for its direction
+                auto waiting = motor->getCurrentDirection() == ElevatorMotor::Direction::None;
+                if(car.carCalls.test(floor) || (!isBypassing(index)
+                    && (waiting ? car.assignedUp.test(floor) || car.assignedDown.test(floor) : getAssigned(car, car.sweep).test(floor))))
+                {
+                    motor->holdDoors();
+                    reachedFloor(floor);
+                }
+            }
+
+            auto target = findTarget(index);
+            if(target == -1)
+                park(index);
+            auto waiting = motor->getCurrentDirection() == ElevatorMotor::Direction::None;
+            // moving car can not stop on floor it is too close to
+            if(target != -1 && target != car.target && motor->goToFloor(target))
+            {
+                car.target = target;
+                plansChanged = true;
+                // waiting car starts new sweep toward target, moving car keeps its sweep
+                if(waiting)
+                    car.sweep = target < motor->getPosition() ? ElevatorMotor::Direction::Down : ElevatorMotor::Direction::Up;
+            }
+        }
+    }
+
+    //! called with car and floor when passenger of the car reached destination
+    void subscribeRequestCompleted(const std::function<void(int, int)>& callBack)
+    {
+        onRequestCompleted = callBack;
+    }
+
+    //! called with car, floor and direction of hall call when the car takes its passengers
+    void subscribeHallCallServed(const std::function<void(int, int, ElevatorMotor::Direction)>& callBack)
+    {
+        onHallCallServed = callBack;
+    }
+
+    //! called with car and floor on every stop of car
+    void subscribeCarStopped(const std::function<void(int, int)>& callBack)
+    {
+        onCarStopped = callBack;
+    }
+
+    int getCarCount() const { return static_cast<int>(cars.size()); }
+    int getFloorCount() const { return floorCount; }
+
+    //! passengers in car from its load sensor
+    void setCarLoad(int carIndex, int passengers)
+    {
+        // full car gives its calls to other cars
+        plansChanged = plansChanged || isBypassing(carIndex) != (passengers >= bypassLoadShare * carCapacity);
+        cars[carIndex].load = passengers;
+    }
+
+    //! without planner cars wait where they stopped
+    void setParkingPlanner(ParkingPlanner* planner) { parking = planner; }
+
+private:
+    bool hasNoCalls(const Car& car) const
+    {
+        return car.carCalls.empty() && car.assignedUp.empty() && car.assignedDown.empty() && car.pickups.empty();
+    }
+
+    //! car without calls goes to parking floor away from other idle cars, decided again after every stop
+    //! and when hour changes
+    void park(int carIndex)
+    {
+        auto& car = cars[carIndex];
+        if(parking == nullptr || car.motor->getCurrentDirection() != ElevatorMotor::Direction::None || car.parkedSlot == parking->getSlot())
+            return;
+        car.parkedSlot = parking->getSlot();
+        parkedFloors.clear();
+        for(int index = 0; index < static_cast<int>(cars.size()); ++index)
+        {
+            // idle car with target goes to its parking floor
+            if(index != carIndex && hasNoCalls(cars[index]))
+                parkedFloors.push_back(cars[index].target != -1 ? cars[index].target : cars[index].motor->getCurrentFloor());
+        }
+        auto floor = parking->chooseParkingFloor(car.motor->getCurrentFloor(), parkedFloors);
+        if(floor == car.motor->getCurrentFloor() || !car.motor->goToFloor(floor))
+            return;
+        elevatorLog()<<"Car "<<carIndex<<" parking on floor - "<<floor<<std::endl;
+        car.target = floor;
+        plansChanged = true;
+        car.sweep = floor < car.motor->getPosition() ? ElevatorMotor::Direction::Down : ElevatorMotor::Direction::Up;
+    }
+
+    bool isBypassing(int carIndex) const { return cars[carIndex].load >= bypassLoadShare * carCapacity; }
+
+    std::vector<int>& getHallCalls(ElevatorMotor::Direction direction)
+    {
+        return direction == ElevatorMotor::Direction::Down ? downCalls : upCalls;
+    }
+
+    FloorSet& getHallCallFloors(ElevatorMotor::Direction direction)
+    {
+        return direction == ElevatorMotor::Direction::Down ? downCallFloors : upCallFloors;
+    }
+
+    static FloorSet& getAssigned(Car& car, ElevatorMotor::Direction direction)
+    {
+        return direction == ElevatorMotor::Direction::Down ? car.assignedDown : car.assignedUp;
+    }
+
+    void assignHallCall(int floor, ElevatorMotor::Direction direction, int carIndex)
+    {
+        auto previousCar = getHallCalls(direction)[floor];
+        getHallCalls(direction)[floor] = carIndex;
+        if(previousCar != noCar)
+            releaseAssigned(previousCar, floor, direction);
+        getHallCallFloors(direction).set(floor);
+        getAssigned(cars[carIndex], direction).set(floor);
+    }
+
+    //! car keeps stop on the floor while it has hall call or destination calls there
+    void releaseAssigned(int carIndex, int floor, ElevatorMotor::Direction direction)
+    {
+        if(getHallCalls(direction)[floor] != carIndex && !hasPickups(carIndex, floor, direction))
+            getAssigned(cars[carIndex], direction).reset(floor);
+    }
+
+    //! returns true if there was hall call
+    bool serveHallCall(int floor, ElevatorMotor::Direction direction)
+    {
+        auto& assigned = getHallCalls(direction)[floor];
+        // call of other car is served too, the car is here already
+        if(assigned == noCar)
+            return false;
+        auto previousCar = assigned;
+        assigned = noCar;
+        releaseAssigned(previousCar, floor, direction);
+        getHallCallFloors(direction).reset(floor);
+        elevatorLog()<<"Car "<<activeCar<<" served hall call floor - "<<floor<<" direction - "<<direction<<std::endl;
+        if(onHallCallServed)
+            onHallCallServed(activeCar, floor, direction);
+        return true;
+    }
+
+    //! passengers of destination calls enter the active car in order of calls while load sensor shows room,
+    //! their destinations become car calls, passengers who do not fit stay in pickups for the next stop
+    bool boardDestinationCalls(int floor, ElevatorMotor::Direction direction)
     {
-        lastTime = std::chrono::steady_clock::now();
+        auto& car = cars[activeCar];
+        auto& pickups = car.pickups;
+        auto room = carCapacity - car.load;
+        auto count = pickups.size();
+        pickups.erase(std::remove_if(pickups.begin(), pickups.end(), [&] (const DestinationCall& call)
+        {
+            if(room <= 0 || call.origin != floor || call.direction != direction)
+                return false;
+            room--;
+            car.carCalls.set(call.destination);
+            return true;
+        }), pickups.end());
+        if(pickups.size() == count)
+            return false;
+        releaseAssigned(activeCar, floor, direction);
+        return true;
     }
-    enum Direction { Up = 1, None = 0, Down = -1 };
-    int getCurrentFloor() { return static_cast<int>(std::round(currentPosition)); }
-    Direction getCurrentDirection() { return currentDirection; }
-    void goToFloor(int floor)
+
+    bool hasPickups(int carIndex, int floor, ElevatorMotor::Direction direction) const
     {
-        if(floor == getCurrentFloor())
-            return;
+        const auto& pickups = cars[carIndex].pickups;
+        return std::any_of(pickups.begin(), pickups.end(), [&] (const DestinationCall& call)
+        {
+            return call.origin == floor && call.direction == direction;
+        });
+    }
 
-        std::cout<<"Go to floor "<<floor<<std::endl;
+    //! car stops on the floor for destination of passenger who is not in car yet
+    bool hasPlannedStop(int carIndex, int floor) const
+    {
+        const auto& pickups = cars[carIndex].pickups;
+        return std::any_of(pickups.begin(), pickups.end(), [&] (const DestinationCall& call) { return call.destination == floor; });
+    }
 
-        destinationFloor = floor;
-        currentDirection = destinationFloor < getCurrentFloor() ? ElevatorMotor::Direction::Down : ElevatorMotor::Direction::Up;
+    int findStopAhead(int carIndex, float position, ElevatorMotor::Direction direction) const
+    {
+        const auto& car = cars[carIndex];
+        // full car passes hall calls and its passengers of destination calls, they wait until passengers leave
+        if(isBypassing(carIndex))
+            return ::findStopAhead(car.carCalls, noCalls, noCalls, floorCount, position, direction);
+        return ::findStopAhead(car.carCalls, car.assignedUp, car.assignedDown, floorCount, position, direction);
     }
 
-    void work()
+    //! the next stop in sweep direction, waiting car looks in opposite direction too
+    int findTarget(int carIndex) const
     {
-        auto now = std::chrono::steady_clock::now();
-        auto delta = now - lastTime;
-        auto floatDelta = std::chrono::duration_cast<std::chrono::milliseconds>(delta).count() * 0.001f;
-        if(currentDirection == Direction::None)
-            return;
+        const auto& car = cars[carIndex];
+        auto position = car.motor->getBrakingPosition();
+        auto direction = car.sweep == ElevatorMotor::Direction::None ? ElevatorMotor::Direction::Up : car.sweep;
+        auto stop = findStopAhead(carIndex, position, direction);
+        if(stop != -1)
+            return stop;
+        // moving car can not turn back before it stops
+        if(car.motor->getCurrentDirection() != ElevatorMotor::Direction::None)
+            return car.target;
+        stop = findStopAhead(carIndex, position, getOppositeDirection(direction));
+        return stop != -1 ? stop : car.target;
+    }
 
-        currentPosition += speed * static_cast<float>(currentDirection) * floatDelta;
+    //! estimated seconds until car stops for call of every floor and direction, the sweep of car followed from stop
+    //! to stop once, so the cost does not depend on number of calls that ask for the estimate
+    void estimateArrivals(int carIndex)
+    {
+        auto& car = cars[carIndex];
+        const auto& kinematics = car.motor->getKinematics();
+        auto travelTime = [&] (float from, int to) { return kinematics.travelTime(std::abs(static_cast<double>(to) - from)); };
+        auto position = car.motor->getPosition();
+        auto sweep = car.sweep;
+        std::fill(car.arrivalUp.begin(), car.arrivalUp.end(), unknownArrival);
+        std::fill(car.arrivalDown.begin(), car.arrivalDown.end(), unknownArrival);
+        // the first estimate of floor is kept, later legs reach it again only after it is served
+        auto arrive = [&] (int floor, ElevatorMotor::Direction direction, double seconds)
+        {
+            auto& arrival = getArrivals(car, direction)[floor];
+            if(arrival == unknownArrival)
+                arrival = seconds;
+        };
 
-        if(std::abs(static_cast<float >(destinationFloor) - currentPosition) <= 0.01f)
+        double seconds = 0.0;
+        // sweep in direction of car, back and again in the first direction reaches any floor
+        for(int leg = 0; leg < 3 && sweep != ElevatorMotor::Direction::None; ++leg)
         {
-            currentDirection = Direction::None;
-            std::cout<<"stop moving on the floor "<<getCurrentFloor()<<"\n";
+            auto stop = findStopAhead(carIndex, position, sweep);
+            auto step = static_cast<int>(sweep);
+            auto first = sweep == ElevatorMotor::Direction::Up ? static_cast<int>(std::floor(position)) + 1
+                                                               : static_cast<int>(std::ceil(position)) - 1;
+            auto last = stop != -1 ? stop : (sweep == ElevatorMotor::Direction::Up ? floorCount - 1 : 0);
+            // call of sweep direction is served on the way, call of opposite direction where car turns,
+            // with nothing more ahead car goes to the call
+            for(auto floor = first; (floor - last) * step <= 0; floor += step)
+            {
+                auto floorSeconds = seconds + travelTime(position, floor);
+                arrive(floor, sweep, floorSeconds);
+                if(stop == -1 || stop == floor)
+                    arrive(floor, getOppositeDirection(sweep), floorSeconds);
+            }
+            if(stop == -1)
+            {
+                sweep = getOppositeDirection(sweep);
+                continue;
+            }
+            seconds += travelTime(position, stop) + kinematics.getDoorCycleSeconds();
+            position = static_cast<float>(stop);
+            // the stop is the last one ahead, car turns on it
+            if(findStopAhead(carIndex, position, sweep) == -1)
+                sweep = getOppositeDirection(sweep);
+            else
+                leg--;
+        }
+        // waiting car and car after three legs go straight to the call
+        for(int floor = 0; floor < floorCount; ++floor)
+        {
+            arrive(floor, ElevatorMotor::Direction::Up, seconds + travelTime(position, floor));
+            arrive(floor, ElevatorMotor::Direction::Down, seconds + travelTime(position, floor));
         }
     }
-private:
-    Direction currentDirection = None;
-    float currentPosition = 0.0f;
-    int destinationFloor = 0;
-    float speed = 0.3f;
-
-    std::chrono::steady_clock::time_point lastTime;
-};
 
-class ElevatorControllerBase
-{
-    // called when an up or down button was pushed on a floor
-    virtual void summonButtonPushed(int summoningFloor, ElevatorMotor::Direction direction) = 0;
+    void estimateArrivals()
+    {
+        for(int index = 0; index < static_cast<int>(cars.size()); ++index)
+            estimateArrivals(index);
+    }
 
-    // called when a button for a floor is pushed inside the car
-    virtual void floorButtonPushed(int destinationFloor) = 0;
+    static std::vector<double>& getArrivals(Car& car, ElevatorMotor::Direction direction)
+    {
+        return direction == ElevatorMotor::Direction::Down ? car.arrivalDown : car.arrivalUp;
+    }
 
-    // called when the car has reached a particular floor
-    virtual void reachedFloor(int floor) = 0;
-};
+    //! from the last estimateArrivals of the car
+    double getArrival(int carIndex, int floor, ElevatorMotor::Direction direction) const
+    {
+        const auto& car = cars[carIndex];
+        return direction == ElevatorMotor::Direction::Down ? car.arrivalDown[floor] : car.arrivalUp[floor];
+    }
 
-template<size_t _FLOOR_COUNT>
-class ElevatorController : public ElevatorControllerBase
-{
-    struct FloorRequest
+    //! full cars get calls only when all cars are full, arrivals of cars must be estimated before
+    int findBestCar(int floor, ElevatorMotor::Direction direction, int currentCar) const
     {
-        int floor = 0;
-        ElevatorMotor::Direction direction = ElevatorMotor::Direction::None;
-    };
+        for(auto skipFull : {true, false})
+        {
+            auto keepCurrent = currentCar != noCar && !(skipFull && isBypassing(currentCar));
+            int bestCar = keepCurrent ? currentCar : noCar;
+            double bestSeconds = keepCurrent ? getArrival(currentCar, floor, direction) - reassignSeconds
+                                             : std::numeric_limits<double>::max();
+            for(int index = 0; index < static_cast<int>(cars.size()); ++index)
+            {
+                if(index == currentCar || (skipFull && isBypassing(index)))
+                    continue;
+                auto seconds = getArrival(index, floor, direction);
+                if(seconds < bestSeconds)
+                {
+                    bestSeconds = seconds;
+                    bestCar = index;
+                }
+            }
+            if(bestCar != noCar)
+                return bestCar;
+        }
+        return currentCar == noCar ? 0 : currentCar;
+    }
 
-    struct QueuedRequest
+    //! calls that car does not go to right now can move to other car, only floors with calls are visited.
+    //! Arrivals are estimated once for the pass, calls moved in it change them for the next pass
+    void reassignHallCalls()
     {
-        QueuedRequest(bool isDestination, FloorRequest* request)
-        : isDestination()
-        , request(request)
+        estimateArrivals();
+        for(auto direction : {ElevatorMotor::Direction::Up, ElevatorMotor::Direction::Down})
         {
+            const auto& calls = getHallCalls(direction);
+            const auto& floors = getHallCallFloors(direction);
+            for(auto floor = floors.findNext(0); floor != -1; floor = floors.findNext(floor + 1))
+            {
+                auto assigned = calls[floor];
+                if(cars[assigned].target == floor)
+                    continue;
+                auto best = findBestCar(floor, direction, assigned);
+                if(best != assigned)
+                {
+                    elevatorLog()<<"Hall call floor - "<<floor<<" moved from car "<<assigned<<" to car "<<best<<std::endl;
+                    assignHallCall(floor, direction, best);
+                }
+            }
         }
-        bool isDestination = false;
-        ElevatorMotor::Direction direction = ElevatorMotor::Direction::None;
-        FloorRequest* request;
-    };
+    }
+
+    int floorCount;
+    int carCapacity;
+    std::vector<Car> cars;
+    //! car assigned to hall call of every floor and direction, noCar if there is no call
+    std::vector<int> upCalls;
+    std::vector<int> downCalls;
+    //! floors with hall calls, for visit of calls without walk over all floors
+    FloorSet upCallFloors;
+    FloorSet downCallFloors;
+    //! always empty, hall calls of bypassing car
+    FloorSet noCalls;
+    ParkingPlanner* parking = nullptr;
+    //! floors of other idle cars for parking decision, kept to avoid allocation
+    std::vector<int> parkedFloors;
+    //! car of current event, for interface calls without car
+    int activeCar = 0;
+    //! calls, stops, targets or full cars changed since hall calls were reassigned
+    bool plansChanged = true;
+    std::function<void(int, int)> onRequestCompleted;
+    std::function<void(int, int, ElevatorMotor::Direction)> onHallCallServed;
+    std::function<void(int, int)> onCarStopped;
+};
 
+//! Bounded lock-free queue of many producers and one consumer on ring of cells (Vyukov). Every cell has sequence
+//! number: producer claims position by compare and swap of tail and publishes cell by its sequence, so the consumer
+//! never sees half written value. Nothing is allocated after construction, capacity is rounded up to power of two
+template<typename T>
+class MpscRing
+{
 public:
-    explicit ElevatorController(ElevatorMotor* motor)
-    : motor(motor)
+    explicit MpscRing(size_t capacity)
     {
-        assert(_FLOOR_COUNT > 1);
-        lastFloor = motor->getCurrentFloor();
+        size_t size = 2;
+        while(size < capacity)
+            size *= 2;
+        cells = std::unique_ptr<Cell[]>(new Cell[size]);
+        mask = size - 1;
+        for(size_t index = 0; index < size; ++index)
+            cells[index].sequence.store(index, std::memory_order_relaxed);
     }
 
-    // called when an up or down button was pushed on a floor
-    void summonButtonPushed(int summoningFloor, ElevatorMotor::Direction direction) override
+    //! any thread, returns false when ring is full
+    bool tryPush(const T& value)
     {
-        std::cout<<"Summon btn pushed floor - "<<summoningFloor<<" direction - "<<direction<<std::endl;
-
-        //! do not make request if already have one
-        auto it = std::find_if(requestQueue.begin(), requestQueue.end(), [=] (QueuedRequest r)
+        auto position = tail.load(std::memory_order_relaxed);
+        while(true)
         {
-            return r.request->floor == summoningFloor && r.direction == direction;
-        });
-
-        if(it != requestQueue.end())
-            return;
+            auto& cell = cells[position & mask];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if(difference == 0)
+            {
+                if(tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(difference < 0)
+                return false;
+            else
+                position = tail.load(std::memory_order_relaxed);
+        }
+    }
 
-        auto request = MakeRequest(summoningFloor, direction);
-        requestQueue.emplace_back(false, request);
-        requestQueue.back().direction = direction;
+    //! consumer thread only, returns false when there is no published value
+    bool tryPop(T& out)
+    {
+        auto& cell = cells[head & mask];
+        if(cell.sequence.load(std::memory_order_acquire) != head + 1)
+            return false;
+        out = cell.value;
+        // cell is free for producer of the next round
+        cell.sequence.store(head + mask + 1, std::memory_order_release);
+        head++;
+        return true;
     }
 
-    // called when a button for a floor is pushed inside the car
-    void floorButtonPushed(int destinationFloor) override
+    //! consumer thread only
+    bool hasPending() const
     {
-        std::cout<<"Floor btn pushed floor - "<<destinationFloor<<std::endl;
+        return cells[head & mask].sequence.load(std::memory_order_acquire) == head + 1;
+    }
 
-        if(destinationFloor == motor->getCurrentFloor())
-            return;
+    size_t capacity() const { return mask + 1; }
 
-        //! do not make request if already have one
-        auto it = std::find_if(requestQueue.begin(), requestQueue.end(), [=] (QueuedRequest r)
-        {
-            return r.request->floor == destinationFloor;
-        });
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
 
-        if(it != requestQueue.end())
-            return;
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    //! producers and consumer write different cache lines
+    alignas(64) std::atomic<size_t> tail {0};
+    alignas(64) size_t head = 0;
+};
 
-        auto direction = destinationFloor < motor->getCurrentFloor() ? ElevatorMotor::Direction::Down : ElevatorMotor::Direction::Up;
-        auto request = MakeRequest(destinationFloor, direction);
-        requestQueue.emplace_back(true, request);
+//! Input events of controller posted from any thread (button panels, floor sensors) and applied by the control
+//! thread in batches before work(), so controller is changed by one thread only and input never waits for
+//! control loop. Full ring makes posting thread yield until control thread drains it, events are never lost
+class ControllerInbox
+{
+public:
+    explicit ControllerInbox(size_t capacity = 1024)
+    : ring(capacity)
+    {
     }
 
-    // called when the car has reached a particular floor
-    void reachedFloor(int floor) override
+    void summonButtonPushed(int summoningFloor, ElevatorMotor::Direction direction)
     {
-        std::cout<<"Reached floor - "<<floor<<std::endl;
-        auto request = requestedFloors[floor];
-        if(request == nullptr)
-            return;
+        post(Event {Event::Type::Summon, summoningFloor, direction});
+    }
 
-        if(request->direction == motor->getCurrentDirection()
-            || isBothDirectionRequest(request)
-            || request == currentRequest)
-        {
-            if(request == currentRequest)
-                currentRequest = nullptr;
+    void floorButtonPushed(int destinationFloor)
+    {
+        post(Event {Event::Type::FloorButton, destinationFloor, ElevatorMotor::Direction::None});
+    }
 
-            TryRemoveQueuedRequest(request);
+    void reachedFloor(int floor)
+    {
+        post(Event {Event::Type::ReachedFloor, floor, ElevatorMotor::Direction::None});
+    }
 
-            if(!isBothDirectionRequest(request) || floor == 0 || floor == _FLOOR_COUNT-1)
+    //! control thread, applies at most maxBatch events to controller, returns count of applied events
+    template<typename Controller>
+    size_t drain(Controller& controller, size_t maxBatch = 64)
+    {
+        Event event;
+        size_t count = 0;
+        while(count < maxBatch && ring.tryPop(event))
+        {
+            switch(event.type)
             {
-                requestedFloors[floor] = nullptr;
-                delete request;
-                RemoveQueuedRequest(request);
-                requestCount--;
-                std::cout<<"FloorRequest removed. Count - "<<requestCount<<std::endl;
+            case Event::Type::Summon:
+                controller.summonButtonPushed(event.floor, event.direction);
+                break;
+            case Event::Type::FloorButton:
+                controller.floorButtonPushed(event.floor);
+                break;
+            case Event::Type::ReachedFloor:
+                controller.reachedFloor(event.floor);
+                break;
             }
-            else
-                request->direction = getOppositeDirection(motor->getCurrentDirection());
-
-            std::cout<<"Complete move to requested floor "<<floor<<std::endl;
-            if(onRequestCompleted)
-                onRequestCompleted();
+            count++;
         }
+        return count;
     }
 
-    void work()
+    //! control thread sleeps until the time point or until any event is posted, returns true if there are events
+    bool waitUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto posted = wakeup.wait_until(lock, deadline, [this] { return ring.hasPending(); });
+        sleeping.store(false);
+        return posted;
+    }
+
+    //! how many times posting thread found ring full
+    size_t getFullCount() const { return fullCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Event
+    {
+        enum class Type { Summon, FloorButton, ReachedFloor };
+        Type type;
+        int floor;
+        ElevatorMotor::Direction direction;
+    };
+
+    void post(const Event& event)
     {
-        if(motor->getCurrentDirection() == ElevatorMotor::Direction::None && !requestQueue.empty())
+        while(!ring.tryPush(event))
         {
-            auto request = requestQueue.front();
-            requestQueue.pop_front();
-            motor->goToFloor(request.request->floor);
+            fullCount.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
         }
+        // either control thread sees the event before it sleeps or poster sees it sleeping and wakes it,
+        // posting does not lock while control thread works
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(sleeping.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wakeup.notify_one();
+        }
+    }
+
+    MpscRing<Event> ring;
+    std::atomic<size_t> fullCount {0};
+    std::atomic<bool> sleeping {false};
+    std::mutex wakeMutex;
+    std::condition_variable wakeup;
+};
+
+
+enum class TrafficProfile { UpPeak, DownPeak, Lunch, Interfloor };
+
+struct Passenger
+{
+    double arrivalTime = 0.0;
+    int origin = 0;
+    int destination = 0;
+    double boardTime = -1.0;
+    double exitTime = -1.0;
+    int car = -1;
+    //! car given by destination dispatch, passenger does not enter other cars
+    int assignedCar = -1;
+    //! passenger did not fit into full car at least once
+    bool leftBehind = false;
+    //! stops of car from boarding to exit, exit stop included
+    int stops = 0;
+};
 
-        motor->work();
-        if(motor->getCurrentFloor() != lastFloor)
+//! Passengers with Poisson arrivals, share of trips from and to lobby (floor 0) set by profile,
+//! other trips between random floors
+class TrafficGenerator
+{
+public:
+    TrafficGenerator(TrafficProfile profile, int floorCount, double passengersPerMinute, unsigned int seed)
+    : floorCount(floorCount)
+    , arrivalDelay(passengersPerMinute / 60.0)
+    , rGen(seed)
+    {
+        switch(profile)
         {
-            lastFloor = motor->getCurrentFloor();
-            reachedFloor(lastFloor);
+        case TrafficProfile::UpPeak: fromLobbyShare = 0.85; toLobbyShare = 0.05; break;
+        case TrafficProfile::DownPeak: fromLobbyShare = 0.05; toLobbyShare = 0.85; break;
+        case TrafficProfile::Lunch: fromLobbyShare = 0.45; toLobbyShare = 0.45; break;
+        case TrafficProfile::Interfloor: break;
         }
     }
 
-    void subscribeRequestCompleted(const std::function<void()>& callBack)
+    Passenger next()
     {
-        onRequestCompleted = callBack;
+        Passenger passenger;
+        time += arrivalDelay(rGen);
+        passenger.arrivalTime = time;
+        auto kind = std::uniform_real_distribution<double>(0.0, 1.0)(rGen);
+        std::uniform_int_distribution<int> upperFloor(1, floorCount - 1);
+        if(kind < fromLobbyShare)
+            passenger.destination = upperFloor(rGen);
+        else if(kind < fromLobbyShare + toLobbyShare)
+            passenger.origin = upperFloor(rGen);
+        else
+        {
+            std::uniform_int_distribution<int> anyFloor(0, floorCount - 1);
+            passenger.origin = anyFloor(rGen);
+            do
+                passenger.destination = anyFloor(rGen);
+            while(passenger.destination == passenger.origin);
+        }
+        return passenger;
     }
 
 private:
+    int floorCount;
+    double fromLobbyShare = 0.0;
+    double toLobbyShare = 0.0;
+    double time = 0.0;
+    std::exponential_distribution<double> arrivalDelay;
+    std::mt19937 rGen;
+};
+
+//! Passengers of generator come in simulated time, press summon buttons, board cars that serve their hall call
+//! and press destination inside, leave the car when it stops on destination. Passengers who do not fit
+//! into full car press the button again, with destination dispatch the controller keeps their call.
+//! Controller is connected with callbacks, so the same benchmark measures any controller
+class ElevatorBenchmark
+{
+    //! passenger who did not fit presses button again when the car leaves
+    static constexpr double callAgainSeconds = 5.0;
+
+public:
+    ElevatorBenchmark(EventQueue* events, TrafficGenerator* generator, int floorCount, int carCount, int carCapacity)
+    : events(events)
+    , generator(generator)
+    , carCapacity(carCapacity)
+    , waiting(floorCount)
+    , riding(carCount)
+    {
+    }
+
+    //! controller actions, called by benchmark
+    std::function<void(int, ElevatorMotor::Direction)> summon;
+    std::function<void(int, int)> pressFloorButton;
+    //! destination dispatch instead of summon and floor buttons, returns assigned car
+    std::function<int(int, int)> destinationCall;
+    //! load sensor, car and count of passengers inside
+    std::function<void(int, int)> reportLoad;
+
+    //! passengers come until the end time
+    void start(double endTime)
+    {
+        arrivalEndTime = endTime;
+        scheduleArrival();
+    }
+
+    //! controller callback, passengers of the direction board the car, both directions for None
+    void hallCallServed(int car, int floor, ElevatorMotor::Direction direction)
+    {
+        auto& floorPassengers = waiting[floor];
+        for(size_t i = 0; i < floorPassengers.size();)
+        {
+            auto& passenger = passengers[floorPassengers[i]];
+            if((direction != ElevatorMotor::Direction::None && getDirection(passenger) != direction)
+                || (passenger.assignedCar != -1 && passenger.assignedCar != car))
+            {
+                ++i;
+                continue;
+            }
+            if(static_cast<int>(riding[car].size()) >= carCapacity)
+            {
+                if(!passenger.leftBehind)
+                    leftBehindCount++;
+                passenger.leftBehind = true;
+                // controller keeps destination call of passenger who did not fit
+                if(!destinationCall)
+                    events->schedule(events->now() + callAgainSeconds, &ElevatorBenchmark::onCallAgain, this, static_cast<int>(floorPassengers[i]));
+                ++i;
+                continue;
+            }
+            passenger.boardTime = events->now();
+            passenger.car = car;
+            riding[car].push_back(floorPassengers[i]);
+            // with destination dispatch the car knows destination already
+            if(!destinationCall)
+                pressFloorButton(car, passenger.destination);
+            // passengers keep order of arrival, car of destination dispatch takes them in order of calls
+            floorPassengers.erase(floorPassengers.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+        if(reportLoad)
+            reportLoad(car, static_cast<int>(riding[car].size()));
+    }
 
-    FloorRequest* MakeRequest(int floor, ElevatorMotor::Direction direction)
+    //! controller callback, passengers of the car with this destination leave it
+    void carStopped(int car, int floor)
     {
-        auto request = requestedFloors[floor];
-        if(request == nullptr)
+        auto& carPassengers = riding[car];
+        for(size_t i = 0; i < carPassengers.size();)
         {
-            request = new FloorRequest {floor, direction };
-            requestedFloors[floor] = request;
-            requestCount++;
-            std::cout<<"FloorRequest created. Count - "<<requestCount<<std::endl;
+            auto& passenger = passengers[carPassengers[i]];
+            passenger.stops++;
+            if(passenger.destination != floor)
+            {
+                ++i;
+                continue;
+            }
+            passenger.exitTime = events->now();
+            deliveredCount++;
+            carPassengers[i] = carPassengers.back();
+            carPassengers.pop_back();
         }
-        else if(request->direction != direction)
+        if(reportLoad)
+            reportLoad(car, static_cast<int>(carPassengers.size()));
+    }
+
+    bool allDelivered() const { return deliveredCount == passengers.size(); }
+
+    void report(std::ostream& out, double cpuMilliseconds) const
+    {
+        std::vector<double> waitTimes, journeyTimes;
+        double stopsSum = 0.0;
+        std::vector<int> deliveredPerWindow;
+        const double windowSeconds = 300.0;
+        for(const auto& passenger : passengers)
         {
-            // Both direction request on the floor
-            request->direction = ElevatorMotor::Direction::None;
+            if(passenger.exitTime < 0.0)
+                continue;
+            waitTimes.push_back(passenger.boardTime - passenger.arrivalTime);
+            journeyTimes.push_back(passenger.exitTime - passenger.arrivalTime);
+            stopsSum += passenger.stops;
+            auto window = static_cast<size_t>(passenger.exitTime / windowSeconds);
+            if(window >= deliveredPerWindow.size())
+                deliveredPerWindow.resize(window + 1, 0);
+            deliveredPerWindow[window]++;
         }
 
-        return request;
+        out<<"  passengers "<<passengers.size()<<", delivered "<<deliveredCount<<"\n";
+        if(waitTimes.empty())
+            return;
+        printTimes(out, "wait", waitTimes);
+        printTimes(out, "journey", journeyTimes);
+        out<<"  handling capacity "<<*std::max_element(deliveredPerWindow.begin(), deliveredPerWindow.end())
+           <<" passengers per 5 minutes, stops per trip "<<stopsSum / static_cast<double>(waitTimes.size())
+           <<", left by full car "<<leftBehindCount<<" passengers, cpu time "<<cpuMilliseconds<<" ms\n";
     }
 
-    void TryRemoveQueuedRequest(FloorRequest* request)
+private:
+    static ElevatorMotor::Direction getDirection(const Passenger& passenger)
     {
-        requestQueue.erase(std::remove_if(requestQueue.begin(), requestQueue.end(), [=] (const QueuedRequest& r)
-        {
-            return r.request->floor == request->floor && (r.direction == motor->getCurrentDirection()
-                                                          || r.isDestination
-                                                          || request->floor == 0 || request->floor == _FLOOR_COUNT-1);
-        }), requestQueue.end());
+        return passenger.destination > passenger.origin ? ElevatorMotor::Direction::Up : ElevatorMotor::Direction::Down;
     }
 
-    void RemoveQueuedRequest(FloorRequest* request)
+    //! nearest rank percentiles of sorted copy
+    static void printTimes(std::ostream& out, const char* name, std::vector<double> times)
     {
-        requestQueue.erase(std::remove_if(requestQueue.begin(), requestQueue.end(), [=] (const QueuedRequest& r)
+        std::sort(times.begin(), times.end());
+        auto percentile = [&] (double share)
         {
-            return r.request == request;
-        }), requestQueue.end());
+            auto rank = static_cast<size_t>(std::ceil(share * static_cast<double>(times.size())));
+            return times[std::max<size_t>(rank, 1) - 1];
+        };
+        double sum = 0.0;
+        for(auto time : times)
+            sum += time;
+        out<<"  "<<name<<" time average "<<sum / static_cast<double>(times.size())<<" s, p50 "<<percentile(0.5)
+           <<" s, p95 "<<percentile(0.95)<<" s, p99 "<<percentile(0.99)<<" s\n";
     }
 
-    ElevatorMotor::Direction getOppositeDirection(ElevatorMotor::Direction direction)
+    // the next passenger is generated when the previous one comes, so queue of events stays short
+    void scheduleArrival()
     {
-        if(direction == ElevatorMotor::Direction::Down)
-            return ElevatorMotor::Direction::Up;
-        if(direction == ElevatorMotor::Direction::Up)
-            return ElevatorMotor::Direction::Down;
-        return direction;
+        nextPassenger = generator->next();
+        if(nextPassenger.arrivalTime <= arrivalEndTime)
+            events->schedule(nextPassenger.arrivalTime, &ElevatorBenchmark::onArrival, this);
     }
 
-    bool isBothDirectionRequest(FloorRequest* request)
+    static void onArrival(void* benchmark, int)
     {
-        return request->direction == ElevatorMotor::Direction::None;
+        auto self = static_cast<ElevatorBenchmark*>(benchmark);
+        self->passengers.push_back(self->nextPassenger);
+        self->waiting[self->nextPassenger.origin].push_back(self->passengers.size() - 1);
+        self->call(self->passengers.size() - 1);
+        self->scheduleArrival();
     }
 
-    ElevatorMotor* motor;
-    int lastFloor;
-    //! queue for request
-    std::deque<QueuedRequest> requestQueue;
-    //! requestedFloors for fast check if any request on reached floor that we can complete while moving
-    std::array<FloorRequest*, _FLOOR_COUNT> requestedFloors = {nullptr};
-    FloorRequest* currentRequest = nullptr;
-    std::function<void()> onRequestCompleted;
-    int requestCount = 0;
+    static void onCallAgain(void* benchmark, int passengerIndex)
+    {
+        auto self = static_cast<ElevatorBenchmark*>(benchmark);
+        // other car could take the passenger meanwhile
+        if(self->passengers[passengerIndex].car == -1)
+            self->call(static_cast<size_t>(passengerIndex));
+    }
+
+    void call(size_t passengerIndex)
+    {
+        auto& passenger = passengers[passengerIndex];
+        if(destinationCall)
+            passenger.assignedCar = destinationCall(passenger.origin, passenger.destination);
+        else
+            summon(passenger.origin, getDirection(passenger));
+    }
+
+    EventQueue* events;
+    TrafficGenerator* generator;
+    int carCapacity;
+    double arrivalEndTime = 0.0;
+    Passenger nextPassenger;
+    std::vector<Passenger> passengers;
+    //! indexes of passengers waiting on every floor and riding in every car
+    std::vector<std::vector<size_t>> waiting;
+    std::vector<std::vector<size_t>> riding;
+    size_t deliveredCount = 0;
+    size_t leftBehindCount = 0;
+};
+
+//! runs events until all passengers of traffic are delivered or time is over, tick of control loop after every event,
+//! returns cpu time in milliseconds
+template<typename Tick>
+double runSimulation(EventQueue& events, Tick tick, const ElevatorBenchmark& benchmark, double endTime)
+{
+    auto cpuStart = std::chrono::steady_clock::now();
+    while(!events.empty() && events.nextTime() <= endTime)
+    {
+        events.runNext();
+        tick();
+    }
+    // passengers still inside or waiting after the end of traffic are delivered without new arrivals
+    const double drainSeconds = 3600.0;
+    while(!benchmark.allDelivered() && !events.empty() && events.nextTime() <= endTime + drainSeconds)
+    {
+        events.runNext();
+        tick();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+}
+
+//! control loop in wall time, sleeps until the next event of queue or until event is posted to inbox,
+//! the same end of run as runSimulation, returns cpu time of process in milliseconds
+template<typename Tick>
+double runRealTime(EventQueue& events, Tick tick, ControllerInbox& inbox, const RealTimeClock& clock,
+    const ElevatorBenchmark& benchmark, double endTime)
+{
+    auto cpuStart = std::clock();
+    const double drainSeconds = 3600.0;
+    while(!events.empty() && (events.nextTime() <= endTime || (!benchmark.allDelivered() && events.nextTime() <= endTime + drainSeconds)))
+    {
+        // posted buttons are handled at once, the event waits for them
+        if(!inbox.waitUntil(clock.toTimePoint(events.nextTime())))
+            events.runNext();
+        tick();
+    }
+    return 1000.0 * static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+}
+
+struct BenchmarkOptions
+{
+    int floorCount = 10;
+    //! zero for single car with ElevatorController
+    int carCount = 0;
+    int carCapacity = 13;
+    double simulatedHours = 1.0;
+    //! above zero runs single car in wall time, so many times faster than real time
+    double timeScale = 0.0;
+    bool destinationDispatch = false;
+    //! idle cars go to floors learned from calls
+    bool parking = false;
 };
 
+void benchmarkSingleCar(TrafficGenerator& generator, const BenchmarkOptions& options)
+{
+    SimulatedClock simulatedClock;
+    RealTimeClock realTimeClock(options.timeScale > 0.0 ? options.timeScale : 1.0);
+    EventQueue events(options.timeScale > 0.0 ? static_cast<Clock*>(&realTimeClock) : &simulatedClock);
+    ElevatorMotor motor(&events);
+    ElevatorController controller(&motor, options.floorCount, options.carCapacity);
+    ElevatorBenchmark benchmark(&events, &generator, options.floorCount, 1, options.carCapacity);
+    ParkingPlanner parking(&events, options.floorCount, motor.getKinematics());
+    if(options.parking)
+        controller.setParkingPlanner(&parking);
+    // buttons go through inbox as from panel threads, passengers press car buttons while control thread drains
+    ControllerInbox inbox;
+    auto tick = [&]
+    {
+        do
+            controller.work();
+        while(inbox.drain(controller) > 0);
+    };
+
+    benchmark.summon = [&] (int floor, ElevatorMotor::Direction direction) { inbox.summonButtonPushed(floor, direction); };
+    benchmark.pressFloorButton = [&] (int, int floor) { inbox.floorButtonPushed(floor); };
+    benchmark.reportLoad = [&] (int, int passengers) { controller.setLoad(passengers); };
+    // the car of this controller takes passengers while it passes the floor, every served floor counts as stop
+    controller.subscribeFloorServed([&] (int floor, ElevatorMotor::Direction direction)
+    {
+        benchmark.carStopped(0, floor);
+        benchmark.hallCallServed(0, floor, direction);
+    });
+
+    auto endTime = options.simulatedHours * 3600.0;
+    benchmark.start(endTime);
+    auto cpuTime = options.timeScale > 0.0
+        ? runRealTime(events, tick, inbox, realTimeClock, benchmark, endTime)
+        : runSimulation(events, tick, benchmark, endTime);
+    benchmark.report(std::cout, cpuTime);
+}
+
+void benchmarkGroup(TrafficGenerator& generator, const BenchmarkOptions& options)
+{
+    SimulatedClock clock;
+    EventQueue events(&clock);
+    std::vector<std::unique_ptr<ElevatorMotor>> motors;
+    std::vector<ElevatorMotor*> motorPointers;
+    for(int index = 0; index < options.carCount; ++index)
+    {
+        motors.push_back(std::unique_ptr<ElevatorMotor>(new ElevatorMotor(&events)));
+        motorPointers.push_back(motors.back().get());
+    }
+    ElevatorGroupController controller(motorPointers, options.floorCount, options.carCapacity);
+    ElevatorBenchmark benchmark(&events, &generator, options.floorCount, options.carCount, options.carCapacity);
+    ParkingPlanner parking(&events, options.floorCount, motors.front()->getKinematics());
+    if(options.parking)
+        controller.setParkingPlanner(&parking);
+
+    benchmark.summon = [&] (int floor, ElevatorMotor::Direction direction)
+    {
+        controller.summonButtonPushed(floor, direction);
+        controller.work();
+    };
+    benchmark.pressFloorButton = [&] (int car, int floor) { controller.floorButtonPushed(car, floor); };
+    benchmark.reportLoad = [&] (int car, int passengers) { controller.setCarLoad(car, passengers); };
+    if(options.destinationDispatch)
+    {
+        benchmark.destinationCall = [&] (int originFloor, int destinationFloor)
+        {
+            auto car = controller.destinationCallPushed(originFloor, destinationFloor);
+            controller.work();
+            return car;
+        };
+    }
+    controller.subscribeCarStopped([&] (int car, int floor) { benchmark.carStopped(car, floor); });
+    controller.subscribeHallCallServed([&] (int car, int floor, ElevatorMotor::Direction direction)
+    {
+        benchmark.hallCallServed(car, floor, direction);
+    });
+
+    benchmark.start(options.simulatedHours * 3600.0);
+    auto cpuTime = runSimulation(events, [&] { controller.work(); }, benchmark, options.simulatedHours * 3600.0);
+    benchmark.report(std::cout, cpuTime);
+}
 
-int main()
+//! full car that stops for its passenger keeps hall call of the floor and serves it when it has room again.
+//! Car of 10 places goes up full, one passenger leaves on floor 3 where hall call up waits, others on floor 6.
+//! Passengers who were left do not press the button again. Checks single car and group, false if call is lost
+bool checkFullCarKeepsHallCall()
 {
-    ElevatorMotor motor;
-    ElevatorController<10> controller(&motor);
+    const int capacity = 10;
+    const int callFloor = 3;
+    const int lastFloor = 6;
+    const double endTime = 600.0;
+    auto run = [&] (EventQueue& events, const std::function<void()>& tick)
+    {
+        tick();
+        while(!events.empty() && events.nextTime() <= endTime)
+        {
+            events.runNext();
+            tick();
+        }
+    };
+    // load of car after its passengers leave on the floor, -1 if nobody leaves. After one leaves on call floor car is still full
+    auto loadAfterStop = [&] (int floor, bool& passedCallFloor)
+    {
+        if(floor == callFloor && !passedCallFloor)
+        {
+            passedCallFloor = true;
+            return capacity - 1;
+        }
+        return floor == lastFloor ? 0 : -1;
+    };
+
+    bool singleServed = false;
+    {
+        SimulatedClock clock;
+        EventQueue events(&clock);
+        ElevatorMotor motor(&events);
+        ElevatorController controller(&motor, 10, capacity);
+        bool passedCallFloor = false;
+        bool passedLastFloor = false;
+        // car comes back to the floor only for hall call, its passengers have left
+        controller.subscribeFloorServed([&] (int floor, ElevatorMotor::Direction)
+        {
+            if(passedLastFloor && floor == callFloor)
+                singleServed = true;
+            passedLastFloor = passedLastFloor || floor == lastFloor;
+            auto load = loadAfterStop(floor, passedCallFloor);
+            if(load >= 0)
+                controller.setLoad(load);
+        });
+        controller.setLoad(capacity);
+        controller.floorButtonPushed(callFloor);
+        controller.floorButtonPushed(lastFloor);
+        controller.summonButtonPushed(callFloor, ElevatorMotor::Direction::Up);
+        run(events, [&] { controller.work(); });
+    }
+
+    bool groupServed = false;
+    {
+        SimulatedClock clock;
+        EventQueue events(&clock);
+        ElevatorMotor motor(&events);
+        ElevatorGroupController controller({&motor}, 10, capacity);
+        bool passedCallFloor = false;
+        bool passedLastFloor = false;
+        controller.subscribeCarStopped([&] (int car, int floor)
+        {
+            passedLastFloor = passedLastFloor || floor == lastFloor;
+            auto load = loadAfterStop(floor, passedCallFloor);
+            if(load >= 0)
+                controller.setCarLoad(car, load);
+        });
+        // car has room for passengers of the call only after floor where its passengers leave
+        controller.subscribeHallCallServed([&] (int, int floor, ElevatorMotor::Direction)
+        {
+            if(passedLastFloor && floor == callFloor)
+                groupServed = true;
+        });
+        controller.setCarLoad(0, capacity);
+        controller.floorButtonPushed(0, callFloor);
+        controller.floorButtonPushed(0, lastFloor);
+        controller.summonButtonPushed(callFloor, ElevatorMotor::Direction::Up);
+        run(events, [&] { controller.work(); });
+    }
 
-    std::default_random_engine rGen;
-    std::uniform_int_distribution<int> rand(0, 9);
+    std::cout<<"Full car keeps hall call: single car "<<(singleServed ? "ok" : "lost")
+             <<", group "<<(groupServed ? "ok" : "lost")<<"\n";
+    return singleServed && groupServed;
+}
 
-    controller.subscribeRequestCompleted([&] () {
-        controller.floorButtonPushed(rand(rGen));
+//! passengers of destination calls who do not fit into the car wait for its next visit, the car stops only
+//! where its passengers leave. Car of 2 places gets calls from lobby to floors 2, 4 and 6 in this order,
+//! false if the car stops where nobody leaves or does not deliver everybody
+bool checkDestinationCallsFitCar()
+{
+    const int capacity = 2;
+    const double endTime = 600.0;
+    SimulatedClock clock;
+    EventQueue events(&clock);
+    ElevatorMotor motor(&events);
+    ElevatorGroupController controller({&motor}, 10, capacity);
+    std::vector<int> waiting {2, 4, 6};
+    std::vector<int> riding;
+    bool emptyStop = false;
+    controller.subscribeCarStopped([&] (int car, int floor)
+    {
+        auto leaving = std::remove(riding.begin(), riding.end(), floor);
+        if(leaving == riding.end() && floor != 0)
+            emptyStop = true;
+        riding.erase(leaving, riding.end());
+        controller.setCarLoad(car, static_cast<int>(riding.size()));
+    });
+    // passengers enter in order of calls while there is room
+    controller.subscribeHallCallServed([&] (int car, int floor, ElevatorMotor::Direction)
+    {
+        if(floor != 0)
+            return;
+        while(!waiting.empty() && static_cast<int>(riding.size()) < capacity)
+        {
+            riding.push_back(waiting.front());
+            waiting.erase(waiting.begin());
+        }
+        controller.setCarLoad(car, static_cast<int>(riding.size()));
     });
-    controller.summonButtonPushed(3, ElevatorMotor::Direction::Up);
-    controller.summonButtonPushed(5, ElevatorMotor::Direction::Up);
-    controller.summonButtonPushed(6, ElevatorMotor::Direction::Down);
-    controller.summonButtonPushed(0, ElevatorMotor::Direction::Up);
+    for(auto destination : waiting)
+        controller.destinationCallPushed(0, destination);
 
-    while (true)
+    controller.work();
+    while(!events.empty() && events.nextTime() <= endTime)
     {
+        events.runNext();
         controller.work();
     }
+    auto delivered = waiting.empty() && riding.empty();
+    std::cout<<"Destination calls fit car: "<<(emptyStop ? "stop without passengers" : delivered ? "ok" : "not delivered")<<"\n";
+    return delivered && !emptyStop;
+}
+
+//! short usage for wrong command line, options are described at main
+void printUsage()
+{
+    std::cout<<"Usage: elevator [-v] [--floors F] [--cars N] [--capacity C] [--destination] [--parking]\n"
+             <<"                [--profile up|down|lunch|inter] [--rate P] [--seed S] [--real-time X] [--check] [hours]\n";
+}
+
+//! elevator [-v] [--floors F] [--cars N] [--capacity C] [--destination] [--parking] [--profile up|down|lunch|inter]
+//!          [--rate P] [--seed S] [--real-time X] [--check] [hours]
+//! benchmark of controller on simulated traffic, all profiles by default, building of F floors (10 by default),
+//! P passengers per minute, one car with ElevatorController or group of N cars, C passengers fit in car
+//! (13 by default), --destination makes group
+//! dispatch destination calls entered on floors, --parking sends idle cars to floors where calls are expected
+//! this hour, --real-time runs single car in wall time X times faster,
+//! --check runs scenarios of controllers instead of benchmark, -v prints every event
+//! unknown option, option without value or unknown profile prints usage and exits with 1
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    double passengersPerMinute = 3.0;
+    unsigned int seed = 1;
+    std::vector<std::pair<std::string, TrafficProfile>> profiles {
+        {"up", TrafficProfile::UpPeak}, {"down", TrafficProfile::DownPeak},
+        {"lunch", TrafficProfile::Lunch}, {"inter", TrafficProfile::Interfloor}};
+    std::string profileName;
+    bool check = false;
+    logEnabled = false;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "-v")
+            logEnabled = true;
+        else if(arg == "--floors" && hasValue)
+            options.floorCount = std::atoi(argv[++i]);
+        else if(arg == "--cars" && hasValue)
+            options.carCount = std::atoi(argv[++i]);
+        else if(arg == "--capacity" && hasValue)
+            options.carCapacity = std::atoi(argv[++i]);
+        else if(arg == "--real-time" && hasValue)
+            options.timeScale = std::atof(argv[++i]);
+        else if(arg == "--destination")
+            options.destinationDispatch = true;
+        else if(arg == "--parking")
+            options.parking = true;
+        else if(arg == "--check")
+            check = true;
+        else if(arg == "--profile" && hasValue)
+            profileName = argv[++i];
+        else if(arg == "--rate" && hasValue)
+            passengersPerMinute = std::atof(argv[++i]);
+        else if(arg == "--seed" && hasValue)
+            seed = static_cast<unsigned int>(std::atoi(argv[++i]));
+        else
+        {
+            char* end = nullptr;
+            auto hours = std::strtod(arg.c_str(), &end);
+            if(arg.empty() || *end != '\0' || !(hours > 0.0))
+            {
+                std::cout<<"Error! unknown argument or option without value: "<<arg<<"\n";
+                printUsage();
+                return 1;
+            }
+            options.simulatedHours = hours;
+        }
+    }
+    if(!profileName.empty() && std::none_of(profiles.begin(), profiles.end(),
+                                            [&](const auto& profile) { return profile.first == profileName; }))
+    {
+        std::cout<<"Error! unknown profile "<<profileName<<"\n";
+        printUsage();
+        return 1;
+    }
+
+    if(check)
+    {
+        auto passed = checkFullCarKeepsHallCall();
+        passed = checkDestinationCallsFitCar() && passed;
+        return passed ? 0 : 1;
+    }
+
+    if(options.floorCount < 2 || options.floorCount > FloorSet::maxFloorCount)
+    {
+        std::cout<<"Error! floor count must be from 2 to "<<FloorSet::maxFloorCount<<"\n";
+        return 1;
+    }
+    if(options.carCapacity < 1)
+    {
+        std::cout<<"Error! car capacity must be at least 1\n";
+        return 1;
+    }
+    // destination dispatch is done by group controller, single car too
+    if(options.destinationDispatch && options.carCount == 0)
+        options.carCount = 1;
 
+    for(const auto& profile : profiles)
+    {
+        if(!profileName.empty() && profile.first != profileName)
+            continue;
+        std::cout<<"Profile "<<profile.first<<", "<<options.floorCount<<" floors, "<<passengersPerMinute<<" passengers per minute, "
+                 <<options.simulatedHours<<" hours, "
+                 <<(options.carCount > 0 ? std::to_string(options.carCount) + " cars of group" : std::string("single car"))
+                 <<(options.destinationDispatch ? ", destination dispatch" : "")<<(options.parking ? ", parking" : "")<<"\n";
+        TrafficGenerator generator(profile.second, options.floorCount, passengersPerMinute, seed);
+        if(options.carCount > 0)
+            benchmarkGroup(generator, options);
+        else
+            benchmarkSingleCar(generator, options);
+    }
     return 0;
 }
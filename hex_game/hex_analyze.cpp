@@ -0,0 +1,409 @@
+/*
+ * Batch analysis of hex positions, positions evaluated in parallel on all cores
+ * and results written in order of input, only a window of positions kept in memory
+ *
+ * hex_analyze [options] file...
+ *   file         - text file with position on every line "<size> <cells> [R|B]", cells row by row
+ *                  as '.', 'R' or 'B', side to move is optional, "-" reads from standard input,
+ *                  files with .hxtd extension are read as training shards of self play,
+ *                  .hxgm game collections and .sgf games give every position of every game
+ *   --threads N  - count of worker threads, all cores by default
+ *   --playouts N - Monte Carlo playouts for every position
+ *   --engine mc|mcts|resistance - flat Monte Carlo, tree search with progressive widening for big boards
+ *                  or one ply resistance search
+ *   --policy file
+ *   --window N   - max count of positions in work, memory bound
+ *
+ * Output line for every position: "<index> <column> <row> <value> <playouts> <milliseconds>",
+ * column and row are hex digits as in the game, "<index> finished <winner>" for ended games
+ * and "<index> error <message>" for broken input lines
+ */
+
+#include "hex_engine.h"
+
+struct analysis_job
+{
+  size_t index = 0;
+  optional<hex_board> board;
+  Color side_to_move = Color::none;
+  string error;
+};
+
+// Positions from text files and training shards, one by one in order of files
+class position_source
+{
+public:
+  explicit position_source(vector<string> paths)
+  : paths(std::move(paths)) {}
+
+  bool next(analysis_job& out_job)
+  {
+    while(true)
+    {
+      if(game_board)
+      {
+        if(next_game_position(out_job))
+          return true;
+        game_board.reset();
+        continue;
+      }
+      else if(collection)
+      {
+        if(next_game < collection->size())
+        {
+          if(!collection->get(next_game++, game))
+          {
+            set_error(out_job, "broken game record");
+            return true;
+          }
+          game_board.emplace(game.size);
+          game_move = 0;
+          continue;
+        }
+        collection.reset();
+      }
+      else if(!sgf_text.empty())
+      {
+        if(game.from_sgf(sgf_text, sgf_offset))
+        {
+          game_board.emplace(game.size);
+          game_move = 0;
+          continue;
+        }
+        sgf_text.clear();
+        // game tree started but was not read to the end
+        if(sgf_offset != string::npos)
+        {
+          set_error(out_job, "broken SGF game");
+          return true;
+        }
+      }
+      else if(shards)
+      {
+        if(shards->next(record))
+        {
+          out_job.board.emplace(record.size);
+          for(int cell_index = 0; cell_index < record.size * record.size; ++cell_index)
+            if(record.cells[cell_index] != Color::none)
+              out_job.board->mark_cell(cell_index, record.cells[cell_index]);
+          out_job.side_to_move = record.side_to_move;
+          out_job.error.clear();
+          return true;
+        }
+        shards.reset();
+      }
+      else if(text != nullptr)
+      {
+        string line;
+        if(std::getline(*text, line))
+        {
+          if(line.empty() || line[0] == '#')
+            continue;
+          parse_line(line, out_job);
+          return true;
+        }
+        text = nullptr;
+        file.close();
+      }
+
+      if(next_path >= paths.size())
+        return false;
+      open(paths[next_path++]);
+    }
+  }
+
+private:
+  void open(const string& path)
+  {
+    auto extension = std::filesystem::path(path).extension();
+    if(path == "-")
+      text = &cin;
+    else if(extension == ".hxtd")
+      shards.emplace(vector<string> {path});
+    else if(extension == ".hxgm")
+    {
+      collection.emplace();
+      next_game = 0;
+      if(!collection->open(path))
+      {
+        std::cerr<<"Error! Can not open game collection "<<path<<"\n";
+        collection.reset();
+      }
+    }
+    else if(extension == ".sgf")
+    {
+      std::ifstream sgf_file(path);
+      if(!sgf_file)
+        std::cerr<<"Error! Can not open "<<path<<"\n";
+      sgf_text.assign(std::istreambuf_iterator<char>(sgf_file), std::istreambuf_iterator<char>());
+      sgf_offset = 0;
+    }
+    else
+    {
+      file.open(path);
+      if(file)
+        text = &file;
+      else
+        std::cerr<<"Error! Can not open "<<path<<"\n";
+    }
+  }
+
+  // every position of game from empty board to the last move
+  bool next_game_position(analysis_job& out_job)
+  {
+    if(game_move > game.moves.size())
+      return false;
+    if(game_move > 0)
+      game_board->mark_cell(game.moves[game_move - 1], game.get_move_color(game_move - 1));
+    out_job.board = game_board;
+    out_job.side_to_move = game.get_move_color(game_move);
+    out_job.error.clear();
+    game_move++;
+    return true;
+  }
+
+  static void set_error(analysis_job& out_job, const string& error)
+  {
+    out_job.board.reset();
+    out_job.error = error;
+  }
+
+  static void parse_line(const string& line, analysis_job& out_job)
+  {
+    out_job.board.reset();
+    out_job.error.clear();
+
+    std::istringstream stream(line);
+    int size = 0;
+    string cells, side;
+    stream >> size >> cells >> side;
+    if(size <= 0 || size > max_board_size || cells.size() != static_cast<size_t>(size * size))
+    {
+      out_job.error = "size and cells do not match";
+      return;
+    }
+
+    out_job.board.emplace(size);
+    int red_count = 0, blue_count = 0;
+    for(int cell_index = 0; cell_index < size * size; ++cell_index)
+    {
+      auto symbol = std::toupper(static_cast<unsigned char>(cells[cell_index]));
+      if(symbol == 'R')
+      {
+        out_job.board->mark_cell(cell_index, Color::red);
+        red_count++;
+      }
+      else if(symbol == 'B')
+      {
+        out_job.board->mark_cell(cell_index, Color::blue);
+        blue_count++;
+      }
+      else if(symbol != '.')
+      {
+        out_job.error = string("unknown cell symbol ") + cells[cell_index];
+        out_job.board.reset();
+        return;
+      }
+    }
+
+    // blue moves first in the game, so without side it is blue when stones are equal
+    if(side == "R" || side == "r")
+      out_job.side_to_move = Color::red;
+    else if(side == "B" || side == "b")
+      out_job.side_to_move = Color::blue;
+    else
+      out_job.side_to_move = blue_count > red_count ? Color::red : Color::blue;
+  }
+
+  vector<string> paths;
+  size_t next_path = 0;
+  std::ifstream file;
+  std::istream* text = nullptr;
+  optional<training_reader> shards;
+  training_record record;
+  optional<game_collection> collection;
+  size_t next_game = 0;
+  string sgf_text;
+  size_t sgf_offset = 0;
+  game_record game;
+  optional<hex_board> game_board;
+  size_t game_move = 0;
+};
+
+// Engines of one worker thread, never shared between threads
+struct worker_engines
+{
+  worker_engines(unsigned int seed, const std::shared_ptr<const pattern_policy>& policy)
+  : cpu_red(Color::red, seed)
+  , cpu_blue(Color::blue, seed + 1)
+  , tree_red(Color::red, seed)
+  , tree_blue(Color::blue, seed + 1)
+  , resistance_red(Color::red)
+  , resistance_blue(Color::blue)
+  {
+    cpu_red.set_policy(policy);
+    cpu_blue.set_policy(policy);
+    tree_red.set_policy(policy);
+    tree_blue.set_policy(policy);
+  }
+
+  player_cpu cpu_red;
+  player_cpu cpu_blue;
+  player_mcts tree_red;
+  player_mcts tree_blue;
+  player_resistance resistance_red;
+  player_resistance resistance_blue;
+  resistance_evaluator evaluator;
+  HexGameRules rules;
+};
+
+struct analysis_options
+{
+  int thread_count = std::max(1u, std::thread::hardware_concurrency());
+  unsigned int playout_count = 2600;
+  string engine = "mc";
+  size_t window = 0;
+  std::shared_ptr<const pattern_policy> policy;
+};
+
+string analyze(const analysis_job& job, worker_engines& engines, const analysis_options& options)
+{
+  std::ostringstream out;
+  out<<job.index<<' ';
+  if(!job.board.has_value())
+  {
+    out<<"error "<<job.error;
+    return out.str();
+  }
+
+  const auto& board = job.board.value();
+  auto winner = engines.rules.check_winner(board);
+  if(winner != Color::none)
+  {
+    out<<"finished "<<(winner == Color::blue ? "blue" : "red");
+    return out.str();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  double value;
+  unsigned int playouts = 0;
+  position move {0, 0};
+  if(options.engine == "resistance")
+  {
+    auto& player = job.side_to_move == Color::red ? engines.resistance_red : engines.resistance_blue;
+    move = player.make_move(board);
+    hex_board after_move(board);
+    after_move.mark_cell(move.column, move.row, job.side_to_move);
+    value = engines.evaluator.evaluate(after_move, job.side_to_move);
+  }
+  else if(options.engine == "mcts")
+  {
+    auto& player = job.side_to_move == Color::red ? engines.tree_red : engines.tree_blue;
+    player.set_playout_count(options.playout_count);
+    move = player.make_move(board);
+    value = player.get_move_value(board.to_cell_index(move.column, move.row));
+    playouts = player.get_last_playout_count();
+  }
+  else
+  {
+    auto& player = job.side_to_move == Color::red ? engines.cpu_red : engines.cpu_blue;
+    player.set_playout_count(options.playout_count);
+    move = player.make_move(board);
+    value = player.get_move_value(board.to_cell_index(move.column, move.row));
+    playouts = player.get_last_playout_count();
+  }
+  auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  out<<std::hex<<move.column<<' '<<move.row<<std::dec<<' '<<std::fixed<<std::setprecision(4)<<value
+     <<' '<<playouts<<' '<<std::setprecision(1)<<elapsed;
+  return out.str();
+}
+
+int main(int argc, char** argv)
+{
+  analysis_options options;
+  vector<string> paths;
+  for(int i = 1; i < argc; ++i)
+  {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if(arg == "--threads" && has_value)
+      options.thread_count = std::max(1, std::stoi(argv[++i]));
+    else if(arg == "--playouts" && has_value)
+      options.playout_count = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if(arg == "--engine" && has_value)
+      options.engine = argv[++i];
+    else if(arg == "--window" && has_value)
+      options.window = std::stoul(argv[++i]);
+    else if(arg == "--policy" && has_value)
+    {
+      auto policy = std::make_shared<pattern_policy>();
+      if(!policy->load(argv[++i]))
+      {
+        std::cerr<<"Error! Can not load policy from "<<argv[i]<<"\n";
+        return 1;
+      }
+      options.policy = policy;
+    }
+    else
+      paths.push_back(arg);
+  }
+  if(paths.empty())
+    paths.push_back("-");
+  if(options.window == 0)
+    options.window = static_cast<size_t>(options.thread_count) * 4;
+
+  vector<std::unique_ptr<worker_engines>> engines;
+  for(int index = 0; index < options.thread_count; ++index)
+    engines.push_back(std::make_unique<worker_engines>(static_cast<unsigned int>(time(nullptr)) + index * 2, options.policy));
+
+  // ring of results, slot of position is index % window, position is not read until its slot is written out
+  std::mutex mutex;
+  std::condition_variable result_ready;
+  vector<optional<string>> results(options.window);
+  size_t written = 0;
+
+  auto write_next = [&]
+    {
+      string line;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto& slot = results[written % options.window];
+        result_ready.wait(lock, [&] { return slot.has_value(); });
+        line = std::move(slot.value());
+        slot.reset();
+      }
+      cout<<line<<'\n';
+      written++;
+    };
+
+  position_source source(paths);
+  {
+    thread_pool pool(options.thread_count);
+    size_t submitted = 0;
+    auto job = std::make_shared<analysis_job>();
+    while(source.next(*job))
+    {
+      while(submitted - written >= options.window)
+        write_next();
+
+      job->index = submitted++;
+      pool.submit([&, job] (int worker)
+        {
+          auto line = analyze(*job, *engines[worker], options);
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            results[job->index % options.window] = std::move(line);
+          }
+          result_ready.notify_all();
+        });
+      job = std::make_shared<analysis_job>();
+    }
+
+    while(written < submitted)
+      write_next();
+  }
+  cout.flush();
+
+  return 0;
+}
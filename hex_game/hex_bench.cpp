@@ -0,0 +1,123 @@
+/*
+ * Benchmark of computer player: heap allocations and time of make_move on positions of one game
+ *
+ * hex_bench [--size N] [--playouts N] [--moves N] [--policy file]
+ *
+ * The first move warms up buffers of player, its allocations are shown apart from the steady state.
+ * Also checks that resistance player opens in the middle of empty board, exit code is 1 when it does not
+ */
+
+#include "hex_engine.h"
+
+#include <cstdlib>
+#include <new>
+
+// every allocation of the process goes through these operators, benchmark reads the counter around make_move
+static std::atomic<size_t> allocation_count {0};
+
+void* operator new(size_t size)
+{
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if(auto memory = std::malloc(size == 0 ? 1 : size))
+    return memory;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+  std::free(memory);
+}
+
+int main(int argc, char** argv)
+{
+  int board_size = 11;
+  unsigned int playout_count = 2600;
+  int move_count = 20;
+  std::shared_ptr<pattern_policy> policy;
+  for(int i = 1; i < argc; ++i)
+  {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if(arg == "--size" && has_value)
+      board_size = std::clamp(std::stoi(argv[++i]), 2, max_board_size);
+    else if(arg == "--playouts" && has_value)
+      playout_count = static_cast<unsigned int>(std::stoul(argv[++i]));
+    else if(arg == "--moves" && has_value)
+      move_count = std::max(2, std::stoi(argv[++i]));
+    else if(arg == "--policy" && has_value)
+    {
+      policy = std::make_shared<pattern_policy>();
+      if(!policy->load(argv[++i]))
+      {
+        std::cerr<<"Error! Can not load policy from "<<argv[i]<<"\n";
+        return 1;
+      }
+    }
+  }
+
+  // computer plays blue against random red moves, so every move is a new position
+  hex_board board(board_size);
+  HexGameRules rules;
+  player_cpu player(Color::blue, 1);
+  player.set_playout_count(playout_count);
+  player.set_policy(policy);
+  minstd_rand random(2);
+
+  size_t warm_up_allocations = 0, steady_allocations = 0;
+  double steady_seconds = 0.0;
+  unsigned long long steady_playouts = 0;
+  int steady_moves = 0;
+  for(int move = 0; move < move_count && rules.check_winner(board) == Color::none; ++move)
+  {
+    auto start_count = allocation_count.load();
+    auto start_time = std::chrono::steady_clock::now();
+    auto pos = player.make_move(board);
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    auto allocations = allocation_count.load() - start_count;
+    if(move == 0)
+      warm_up_allocations = allocations;
+    else
+    {
+      steady_allocations += allocations;
+      steady_seconds += seconds;
+      steady_playouts += player.get_last_playout_count();
+      steady_moves++;
+    }
+
+    board.mark_cell(pos.column, pos.row, Color::blue);
+    if(rules.check_winner(board) != Color::none)
+      break;
+    int cell_index;
+    do
+      cell_index = random() % (board_size * board_size);
+    while(board.get_cell(cell_index).color != Color::none);
+    board.mark_cell(cell_index, Color::red);
+  }
+
+  cout<<"warm up move allocations: "<<warm_up_allocations<<"\n";
+  cout<<"steady moves: "<<steady_moves<<", allocations: "<<steady_allocations<<"\n";
+  if(steady_moves > 0)
+  {
+    cout<<std::fixed<<std::setprecision(2);
+    cout<<"milliseconds per move: "<<steady_seconds * 1000.0 / steady_moves<<"\n";
+    cout<<"playouts per second: "<<std::setprecision(0)<<steady_playouts / std::max(steady_seconds, 1e-9)<<"\n";
+  }
+
+  // opening in the middle third of both lines, evaluation alone prefers obtuse corners
+  hex_board empty_board(board_size);
+  player_resistance resistance_player(Color::blue);
+  auto start_time = std::chrono::steady_clock::now();
+  auto opening = resistance_player.make_move(empty_board);
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+  auto is_middle = [board_size](int line) { return line >= board_size / 3 && line < board_size - board_size / 3; };
+  bool is_central = is_middle(opening.column) && is_middle(opening.row);
+  cout<<std::fixed<<std::setprecision(2);
+  cout<<"resistance opening: "<<opening.column<<' '<<opening.row<<(is_central ? "" : ", not central")<<"\n";
+  cout<<"resistance milliseconds per move: "<<seconds * 1000.0<<"\n";
+  return is_central ? 0 : 1;
+}
@@ -0,0 +1,3270 @@
+/*
+ * Engine of the hex game https://en.wikipedia.org/wiki/Hex_(board_game)
+ * board, rules, evaluators and computer players, shared by the game and the tools
+ * header only, include it to one translation unit of executable
+ */
+
+#ifndef HEX_GAME_HEX_ENGINE_H
+#define HEX_GAME_HEX_ENGINE_H
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <deque>
+#include <array>
+#include <bitset>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <algorithm>
+#include <random>
+#include <memory>
+#include <functional>
+#include <optional>
+#include <sstream>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <cctype>
+#include <cstring>
+// uncomment to disable assert()
+// #define NDEBUG
+#include <cassert>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HEX_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <unistd.h>
+#else
+#define HEX_HAS_MMAP 0
+#endif
+
+using std::vector;
+using std::pair;
+using std::cout;
+using std::cin;
+using std::array;
+using std::string;
+using std::minstd_rand;
+using std::priority_queue;
+using std::unordered_map;
+using std::unordered_set;
+using std::optional;
+
+enum class Color
+{
+  none,
+  red,
+  blue,
+};
+
+// biggest supported board, all fixed size tables sized by it
+constexpr int max_board_size = 19;
+constexpr int max_cell_count = max_board_size * max_board_size;
+// set of board cells, bit for every cell index
+using cell_set = std::bitset<max_cell_count>;
+
+// Board symmetry, hex board is symmetric only under rotation on 180 degrees
+// (top edge goes to bottom and left to right, so every color keeps own edges)
+enum class board_symmetry
+{
+  identity,
+  rotate_180,
+};
+
+// Zobrist keys for every cell and color, generated from fixed seed
+// so the same position has the same key in every run of engine
+class zobrist_keys
+{
+public:
+  static uint64_t cell_key(int cell_index, Color color)
+  {
+    assert(cell_index >= 0 && cell_index < max_cell_count && color != Color::none);
+    return instance().keys[cell_index][color == Color::red ? 0 : 1];
+  }
+
+  static uint64_t size_key(int size)
+  {
+    assert(size > 0 && size <= max_board_size);
+    return instance().size_keys[size];
+  }
+
+  //! key of color that moved to position, mixed to keys of positions stored with side
+  static uint64_t side_key(Color color)
+  {
+    return color == Color::red ? instance().red_side_key : 0;
+  }
+
+  //! key mixed to keys of statistics of move, so they never mix with statistics of position
+  static uint64_t move_key() { return instance().move_statistics_key; }
+
+private:
+  zobrist_keys()
+  {
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    for(auto& cell_keys : keys)
+      for(auto& key : cell_keys)
+        key = split_mix(seed);
+    for(auto& key : size_keys)
+      key = split_mix(seed);
+    red_side_key = split_mix(seed);
+    move_statistics_key = split_mix(seed);
+  }
+
+  static const zobrist_keys& instance()
+  {
+    static const zobrist_keys keys_table;
+    return keys_table;
+  }
+
+  static uint64_t split_mix(uint64_t& state)
+  {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  array<array<uint64_t, 2>, max_cell_count> keys;
+  array<uint64_t, max_board_size + 1> size_keys;
+  uint64_t red_side_key;
+  uint64_t move_statistics_key;
+};
+
+struct hex_cell
+{
+  Color color = Color::none;
+  // colors of 12 cells around (6 neighbors and 6 bridge cells), 2 bits for every cell,
+  // see hex_board::pattern_offsets for order, updated by board on every mark
+  uint32_t pattern = 0;
+};
+
+// states of cell in pattern, values of Color enum plus cell out of board
+constexpr uint32_t pattern_off_board = 3;
+constexpr int pattern_cell_count = 12;
+
+struct position
+{
+  position(short column, short row)
+  : column(column)
+  , row(row) {}
+
+  short column = 0;
+  short row = 0;
+};
+
+class hex_board
+{
+  public:
+    explicit hex_board(int size);
+    void assign(const hex_board& other_board);
+    hex_cell get_cell(int column, int row) const;
+    hex_cell get_cell(int cell_index) const;
+    void mark_cell(int cell_index, Color color);
+    void mark_cell(int column, int row, Color color) { mark_cell(to_cell_index(column, row), color); }
+    bool is_valid_position(int column, int row) const;
+    int to_cell_index(int column, int row) const;
+    position to_position(int cell_index) const;
+    int get_size() const { return size; }
+    array<short, 6> get_neighbors(int cell_index) const;
+    //! cells of 12 cells pattern around cell, -1 for cells out of board
+    array<short, pattern_cell_count> get_pattern_cells(int cell_index) const;
+    //! Zobrist key of position as it is on the board
+    uint64_t get_hash() const { return hash; }
+    //! same key for position and its rotated copy, use it for all position keyed storages
+    uint64_t get_canonical_hash() const { return std::min(hash, rotated_hash); }
+    //! canonical key of position after color moves to empty cell, board is not changed
+    uint64_t get_canonical_hash_after(int cell_index, Color color) const
+    {
+      auto rotated_index = transform_cell(cell_index, board_symmetry::rotate_180);
+      return std::min(hash ^ zobrist_keys::cell_key(cell_index, color), rotated_hash ^ zobrist_keys::cell_key(rotated_index, color));
+    }
+    //! symmetry that transform board cells to canonical orientation
+    board_symmetry get_canonical_symmetry() const
+    { return rotated_hash < hash ? board_symmetry::rotate_180 : board_symmetry::identity; }
+    int transform_cell(int cell_index, board_symmetry symmetry) const;
+    //! map move to canonical orientation before store it, and back after load
+    int to_canonical_cell(int cell_index) const { return transform_cell(cell_index, get_canonical_symmetry()); }
+    int from_canonical_cell(int cell_index) const { return transform_cell(cell_index, get_canonical_symmetry()); }
+  private:
+    [[nodiscard]] hex_cell create_cell(int column, int row) const;
+    void set_pattern_cell(int cell_index, uint32_t state);
+
+    // column and row offsets of pattern cells, 6 neighbors in order of get_neighbors and then 6 bridge cells
+    static constexpr array<pair<int, int>, pattern_cell_count> pattern_offsets = {{
+      {0, -1}, {1, -1}, {-1, 0}, {1, 0}, {-1, 1}, {0, 1},
+      {1, -2}, {2, -1}, {1, 1}, {-1, 2}, {-2, 1}, {-1, -1} }};
+  
+    vector<hex_cell> hex_cells;
+    int size;
+    // keys of position and position rotated on 180 degrees, updated on every mark
+    uint64_t hash;
+    uint64_t rotated_hash;
+};
+
+inline hex_board::hex_board(int size)
+: hex_cells(size*size)
+, size(size)
+, hash(zobrist_keys::size_key(size))
+, rotated_hash(hash)
+{
+  int index = 0;
+  for(int row = 0; row < size; ++row)
+  {
+    for(int column = 0; column < size; ++column)
+    {
+      auto cell = create_cell(column, row);
+      hex_cells[index] = cell;
+      index++;
+    }
+  }
+
+  // mark pattern cells out of board once, they never change
+  for(int cell_index = 0; cell_index < size * size; ++cell_index)
+  {
+    auto pos = to_position(cell_index);
+    for(int slot = 0; slot < pattern_cell_count; ++slot)
+    {
+      auto [column_offset, row_offset] = pattern_offsets[slot];
+      if(!is_valid_position(pos.column + column_offset, pos.row + row_offset))
+        hex_cells[cell_index].pattern |= pattern_off_board << (slot * 2);
+    }
+  }
+}
+
+inline void hex_board::assign(const hex_board& other_board)
+{
+  hex_cells.assign(other_board.hex_cells.begin(), other_board.hex_cells.end());
+  size = other_board.size;
+  hash = other_board.hash;
+  rotated_hash = other_board.rotated_hash;
+}
+
+inline void hex_board::mark_cell(int cell_index, Color color)
+{
+  auto& cell = hex_cells[cell_index];
+  // rotation on 180 degrees maps cell (column, row) to (size-1-column, size-1-row)
+  auto rotated_index = transform_cell(cell_index, board_symmetry::rotate_180);
+  if(cell.color != Color::none)
+  {
+    hash ^= zobrist_keys::cell_key(cell_index, cell.color);
+    rotated_hash ^= zobrist_keys::cell_key(rotated_index, cell.color);
+  }
+  if(color != Color::none)
+  {
+    hash ^= zobrist_keys::cell_key(cell_index, color);
+    rotated_hash ^= zobrist_keys::cell_key(rotated_index, color);
+  }
+  cell.color = color;
+  set_pattern_cell(cell_index, static_cast<uint32_t>(color));
+}
+
+inline void hex_board::set_pattern_cell(int cell_index, uint32_t state)
+{
+  // cell is in slot of every cell that lies on opposite offset, all offsets have opposite one in the list
+  auto pos = to_position(cell_index);
+  for(int slot = 0; slot < pattern_cell_count; ++slot)
+  {
+    auto [column_offset, row_offset] = pattern_offsets[slot];
+    auto owner = to_cell_index(pos.column - column_offset, pos.row - row_offset);
+    if(owner == -1)
+      continue;
+    auto& pattern = hex_cells[owner].pattern;
+    pattern = (pattern & ~(3u << (slot * 2))) | (state << (slot * 2));
+  }
+}
+
+inline array<short, pattern_cell_count> hex_board::get_pattern_cells(int cell_index) const
+{
+  auto pos = to_position(cell_index);
+  array<short, pattern_cell_count> result;
+  for(int slot = 0; slot < pattern_cell_count; ++slot)
+    result[slot] = to_cell_index(pos.column + pattern_offsets[slot].first, pos.row + pattern_offsets[slot].second);
+  return result;
+}
+
+inline int hex_board::transform_cell(int cell_index, board_symmetry symmetry) const
+{
+  // rotation is its own inverse, so the same transform maps to and from canonical orientation
+  if(symmetry == board_symmetry::rotate_180)
+    return size * size - 1 - cell_index;
+  return cell_index;
+}
+
+inline bool hex_board::is_valid_position(int column, int row) const
+{
+  return row >= 0 && row < size && column >= 0 && column < size;
+}
+
+inline hex_cell hex_board::get_cell(int column, int row) const
+{
+  auto index = to_cell_index(column, row);
+  return get_cell(index);
+}
+
+inline hex_cell hex_board::get_cell(int cell_index) const
+{
+  assert(cell_index >= 0 && (size_t)cell_index < hex_cells.size());
+  return hex_cells[cell_index];
+}
+
+inline int hex_board::to_cell_index(int column, int row) const
+{
+  if(!is_valid_position(column, row))
+    return -1;
+  return row * size + column;
+}
+
+inline position hex_board::to_position(int cell_index) const
+{
+  short column = cell_index % size;
+  short row = cell_index / size;
+  position result {column, row};
+  return result;
+}
+
+inline array<short, 6> hex_board::get_neighbors(int cell_index) const
+{
+  auto index = to_position(cell_index);
+  int column = index.column, row = index.row;
+  short left = to_cell_index(column - 1, row);
+  short right = to_cell_index(column + 1, row);
+  short top_left = to_cell_index(column, row - 1);
+  short top_right = to_cell_index(column + 1, row - 1);
+  short bottom_left = to_cell_index(column - 1, row + 1);
+  short bottom_right = to_cell_index(column, row + 1);
+  return array<short, 6> {top_left, top_right, left, right, bottom_left, bottom_right };
+}
+
+inline hex_cell hex_board::create_cell(int column, int row) const
+{
+  assert(is_valid_position(column, row));
+  return hex_cell();
+}
+
+// Composes whole frame of board in one preallocated buffer and writes it at once.
+// In terminal mode frame is drawn from top left corner of screen, next frames of the same board
+// only move cursor to changed cells and rewrite them
+class board_renderer
+{
+public:
+  explicit board_renderer(bool terminal_mode = false)
+  : terminal_mode(terminal_mode)
+  {
+    frame.reserve(max_frame_length);
+  }
+
+  //! draw board, highlighted stones drawn in lower case
+  void draw(const hex_board& board, const cell_set& highlight = cell_set())
+  {
+    frame.clear();
+    if(terminal_mode && drawn_size == board.get_size())
+      compose_changes(board, highlight);
+    else
+      compose_frame(board, highlight);
+    cout.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+    cout.flush();
+  }
+
+  //! next frame is drawn in full, call it when other output moved board on the screen
+  void invalidate() { drawn_size = 0; }
+
+private:
+  static char cell_symbol(Color color, bool highlighted)
+  {
+    if(color == Color::red)
+      return highlighted ? 'r' : 'R';
+    if(color == Color::blue)
+      return highlighted ? 'b' : 'B';
+    return '.';
+  }
+
+  void compose_frame(const hex_board& board, const cell_set& highlight)
+  {
+    int size = board.get_size();
+    if(terminal_mode)
+      frame += "\x1b[H\x1b[2J";
+
+    compose_edge_line(padding + 4, size);
+    for(int row = 0, index = 0; row < size; ++row)
+    {
+      append_hex(row, padding + row);
+      frame += " B ";
+      for(int column = 0; column < size; ++column, ++index)
+      {
+        drawn_symbols[index] = cell_symbol(board.get_cell(index).color, highlight.test(index));
+        frame += drawn_symbols[index];
+        if(column != size - 1)
+          frame += '-';
+      }
+      frame += " B ";
+      append_hex(row, 0);
+
+      if(row != size - 1)
+      {
+        frame += '\n';
+        frame.append(padding + 4 + row, ' ');
+        for(int i = 0; i < size + size - 1; ++i)
+          frame += i % 2 == 0 ? '\\' : '/';
+      }
+      frame += '\n';
+    }
+    compose_edge_line(padding + 4 + size - 1, size);
+    frame += "\n\n\n";
+
+    drawn_size = size;
+    end_line = static_cast<int>(std::count(frame.begin(), frame.end(), '\n')) + 1;
+  }
+
+  void compose_changes(const hex_board& board, const cell_set& highlight)
+  {
+    for(int index = 0; index < drawn_size * drawn_size; ++index)
+    {
+      auto symbol = cell_symbol(board.get_cell(index).color, highlight.test(index));
+      if(symbol == drawn_symbols[index])
+        continue;
+      drawn_symbols[index] = symbol;
+      // row of cells is every second line after two lines of edge, cells are two columns apart
+      int row = index / drawn_size, column = index % drawn_size;
+      move_cursor(3 + 2 * row, padding + row + 4 + 2 * column);
+      frame += symbol;
+    }
+    move_cursor(end_line, 1);
+  }
+
+  // column numbers and edge symbols, first of them aligned to width
+  void compose_edge_line(int width, int size)
+  {
+    for(int i = 0; i < size; ++i)
+    {
+      append_hex(i, i == 0 ? width : 0);
+      frame += ' ';
+    }
+    frame += '\n';
+    frame.append(width - 1, ' ');
+    for(int i = 0; i < size; ++i)
+      frame += "R ";
+    frame += '\n';
+  }
+
+  // board coordinates are shown in hex, aligned to right in width
+  void append_hex(int value, int width)
+  {
+    char digits[8];
+    int length = 0;
+    do
+    {
+      digits[length++] = "0123456789abcdef"[value % 16];
+      value /= 16;
+    }
+    while(value > 0);
+    if(length < width)
+      frame.append(width - length, ' ');
+    while(length > 0)
+      frame += digits[--length];
+  }
+
+  // line and column start from 1 in terminal
+  void move_cursor(int line, int column)
+  {
+    frame += "\x1b[";
+    frame += std::to_string(line);
+    frame += ';';
+    frame += std::to_string(column);
+    frame += 'H';
+  }
+
+  static constexpr int padding = 5;
+  static constexpr size_t max_frame_length = (2 * max_board_size + 8) * (4 * max_board_size + 16);
+
+  bool terminal_mode;
+  string frame;
+  array<char, max_cell_count> drawn_symbols {};
+  int drawn_size = 0;
+  int end_line = 0;
+};
+
+class path_finder
+{
+public:
+    static bool search_path(const hex_board& board, const int cell_from, const int cell_to, unordered_map<int, int>* out_predecessor = nullptr)
+    {
+      // priority queue by path cost
+      auto cmp = [](cell_cost left, cell_cost right) { return left.cost > right.cost; };
+      priority_queue<cell_cost, std::vector<cell_cost>, decltype(cmp)> open_set(cmp);
+      
+      // for reconstruct path, "predecessor[B] = A" records A as the predecessor of B, meaning that A discovered B.
+      auto predecessor = out_predecessor;
+      // initial value
+      open_set.push(cell_cost{cell_from, 0});
+      
+      unordered_set<int> closed_set;
+      
+      while(!open_set.empty())
+      {
+        auto next = open_set.top();
+        open_set.pop();
+        
+        auto cell = next.cell;
+        int cost = next.cost;
+        
+        closed_set.insert(cell);
+        // stop search if found destination cell
+        if(cell == cell_to)
+          return true;
+        
+        auto neighbors = board.get_neighbors(cell);
+        for(auto neighbor : neighbors)
+        {
+          if(neighbor != -1)
+          {
+            auto new_cell = neighbor;
+            if(board.get_cell(new_cell).color != board.get_cell(cell_from).color)
+              continue;
+            // if in closed set go to next neighbor 
+            if(closed_set.count(new_cell) > 0)
+              continue;
+            // if have optionally param predecessor, write to it
+            if(predecessor != nullptr && (*predecessor).count(new_cell) == 0)
+              (*predecessor)[new_cell] = cell;
+            // all cost growing by 1
+            open_set.push(cell_cost{new_cell, cost+1});
+          }
+        }
+      }
+      
+      return false;
+    }
+
+    //! minimum count of stones that color needs to add to connect own edges,
+    //! own stones cost 0, empty cells cost 1 and opponent stones block the way
+    //! returns -1 if edges can not be connected anymore
+    int connection_distance(const hex_board& board, Color color)
+    {
+      search_color = color;
+      for(int edge = 0; edge < 2; ++edge)
+        fill_edge_distance(board, color, edge);
+
+      const auto size = board.get_size();
+      int result = unreachable;
+      for(int i = 0; i < size; ++i)
+        result = std::min(result, edge_distance[0][edge_cell(board, color, 1, i)]);
+      return result == unreachable ? -1 : result;
+    }
+
+    //! distance map from edge (0 - top or left, 1 - bottom or right) to every cell calculated by last connection_distance,
+    //! cost of cell itself included, -1 for cells that can not be reached
+    int get_edge_distance(int edge, int cell_index) const
+    {
+      auto distance = edge_distance[edge][cell_index];
+      return distance == unreachable ? -1 : distance;
+    }
+
+    //! count of stones needed to connect edges through the cell, cheap prior for move ordering
+    int get_cell_distance(const hex_board& board, int cell_index) const
+    {
+      auto from_first = edge_distance[0][cell_index];
+      auto from_second = edge_distance[1][cell_index];
+      if(from_first == unreachable || from_second == unreachable)
+        return -1;
+      // cell cost counted in both distances
+      return from_first + from_second - cell_cost_for(board.get_cell(cell_index).color, search_color);
+    }
+
+private:
+  struct cell_cost
+  {
+    int cell;
+    int cost;
+  };
+
+  static constexpr int unreachable = std::numeric_limits<int>::max();
+  static constexpr int blocked = -1;
+
+  static int cell_cost_for(Color cell_color, Color color)
+  {
+    if(cell_color == color)
+      return 0;
+    return cell_color == Color::none ? 1 : blocked;
+  }
+
+  // i-th cell of edge, blue edges are left and right columns, red edges are top and bottom rows
+  static int edge_cell(const hex_board& board, Color color, int edge, int i)
+  {
+    auto line = edge == 0 ? 0 : board.get_size() - 1;
+    return color == Color::blue ? board.to_cell_index(line, i) : board.to_cell_index(i, line);
+  }
+
+  // 0-1 BFS, cells reached by free move go to front of deque and by paid move to back,
+  // so deque always sorted by distance and every cell processed once with final distance
+  void fill_edge_distance(const hex_board& board, Color color, int edge)
+  {
+    auto& distance = edge_distance[edge];
+    distance.assign(board.get_size() * board.get_size(), unreachable);
+    open_cells.clear();
+
+    for(int i = 0; i < board.get_size(); ++i)
+    {
+      auto cell = edge_cell(board, color, edge, i);
+      auto cost = cell_cost_for(board.get_cell(cell).color, color);
+      if(cost == blocked)
+        continue;
+      distance[cell] = cost;
+      if(cost == 0)
+        open_cells.push_front(cell);
+      else
+        open_cells.push_back(cell);
+    }
+
+    while(!open_cells.empty())
+    {
+      auto cell = open_cells.front();
+      open_cells.pop_front();
+
+      for(auto neighbor : board.get_neighbors(cell))
+      {
+        if(neighbor == -1)
+          continue;
+        auto cost = cell_cost_for(board.get_cell(neighbor).color, color);
+        if(cost == blocked || distance[cell] + cost >= distance[neighbor])
+          continue;
+        distance[neighbor] = distance[cell] + cost;
+        if(cost == 0)
+          open_cells.push_front(neighbor);
+        else
+          open_cells.push_back(neighbor);
+      }
+    }
+  }
+
+  // reusable buffers of connection distance search
+  array<vector<int>, 2> edge_distance;
+  std::deque<int> open_cells;
+  Color search_color = Color::none;
+};
+
+// Static evaluation of position: connection of every color modeled as electrical circuit,
+// own stones are almost perfect conductors, empty cells are resistors and opponent stones
+// are removed from circuit. Current between two edges of color shows how good its connection is.
+// Circuit solved with Jacobi preconditioned conjugate gradient, the last solution of every color
+// used as initial guess for next position, neighbor positions differ by one stone so it converges fast.
+// Whole network is rebuilt and solved for every call, about 0.1 ms for both colors on 11x11 board in optimized build.
+class resistance_evaluator
+{
+public:
+  //! positive when position is better for color, log of opponent edges resistance to own edges resistance
+  double evaluate(const hex_board& board, Color color)
+  {
+    auto opponent = color == Color::blue ? Color::red : Color::blue;
+    auto own_resistance = edge_resistance(board, color);
+    auto opponent_resistance = edge_resistance(board, opponent);
+    if(std::isinf(own_resistance) && std::isinf(opponent_resistance))
+      return 0.0;
+    if(std::isinf(opponent_resistance))
+      return max_value;
+    if(std::isinf(own_resistance))
+      return -max_value;
+    return std::clamp(std::log(opponent_resistance / own_resistance), -max_value, max_value);
+  }
+
+  //! resistance between edges of color, infinity when edges can not be connected anymore
+  //! optionally returns current through every cell, good prior for move ordering
+  double edge_resistance(const hex_board& board, Color color, vector<double>* out_cell_current = nullptr)
+  {
+    auto& net = networks[color == Color::red ? 0 : 1];
+    build_network(board, color, net);
+    solve(net);
+
+    double current = 0.0;
+    for(size_t i = 0; i < net.voltage.size(); ++i)
+      current += net.source[i] * (1.0 - net.voltage[i]);
+
+    if(out_cell_current != nullptr)
+      collect_cell_current(net, *out_cell_current);
+
+    return current > min_current ? 1.0 / current : std::numeric_limits<double>::infinity();
+  }
+
+  //! for every cell distance from saddle point of both circuits, |blue voltage - 1/2| + |red voltage - 1/2|,
+  //! cell near 0 is in the middle of both connections, Shannon's Hex machine played there
+  void saddle_distance(const hex_board& board, vector<double>& out_distance)
+  {
+    edge_resistance(board, Color::blue);
+    edge_resistance(board, Color::red);
+    const auto& blue_voltage = networks[1].voltage;
+    const auto& red_voltage = networks[0].voltage;
+    out_distance.resize(blue_voltage.size());
+    for(size_t cell = 0; cell < out_distance.size(); ++cell)
+      out_distance[cell] = std::abs(blue_voltage[cell] - 0.5) + std::abs(red_voltage[cell] - 0.5);
+  }
+
+  static constexpr double max_value = 10.0;
+
+private:
+  // sparse matrix in fixed 6 neighbors layout, row i is Kirchhoff law for cell i
+  struct network
+  {
+    int size = 0;
+    vector<array<double, 6>> conductance;
+    vector<array<short, 6>> neighbors;
+    // conductance to source edge (potential 1) and to sink edge (potential 0)
+    vector<double> source;
+    vector<double> sink;
+    vector<double> diagonal;
+    vector<double> voltage;
+    // conjugate gradient buffers
+    vector<double> residual;
+    vector<double> preconditioned;
+    vector<double> direction;
+    vector<double> product;
+  };
+
+  static double cell_resistance(Color cell_color, Color color)
+  {
+    if(cell_color == color)
+      return own_stone_resistance;
+    if(cell_color == Color::none)
+      return 1.0;
+    return std::numeric_limits<double>::infinity();
+  }
+
+  static void build_network(const hex_board& board, Color color, network& net)
+  {
+    const auto size = board.get_size();
+    const auto cell_count = static_cast<size_t>(size * size);
+    if(net.size != size)
+    {
+      net.size = size;
+      for(auto buffer : {&net.source, &net.sink, &net.diagonal, &net.voltage, &net.residual, &net.preconditioned, &net.direction, &net.product})
+        buffer->assign(cell_count, 0.0);
+      net.conductance.resize(cell_count);
+      net.neighbors.resize(cell_count);
+    }
+
+    for(size_t cell = 0; cell < cell_count; ++cell)
+    {
+      auto& conductance = net.conductance[cell];
+      conductance.fill(0.0);
+      net.neighbors[cell] = board.get_neighbors(static_cast<int>(cell));
+      net.source[cell] = 0.0;
+      net.sink[cell] = 0.0;
+      net.diagonal[cell] = 0.0;
+
+      auto resistance = cell_resistance(board.get_cell(static_cast<int>(cell)).color, color);
+      if(std::isinf(resistance))
+      {
+        // out of circuit, previous solution for this cell has no sense
+        net.voltage[cell] = 0.0;
+        continue;
+      }
+
+      for(int k = 0; k < 6; ++k)
+      {
+        auto neighbor = net.neighbors[cell][k];
+        if(neighbor == -1)
+          continue;
+        auto neighbor_resistance = cell_resistance(board.get_cell(neighbor).color, color);
+        if(!std::isinf(neighbor_resistance))
+          conductance[k] = 1.0 / (resistance + neighbor_resistance);
+        net.diagonal[cell] += conductance[k];
+      }
+
+      // blue connects left and right columns, red connects top and bottom rows
+      auto pos = board.to_position(static_cast<int>(cell));
+      auto line = color == Color::blue ? pos.column : pos.row;
+      if(line == 0)
+      {
+        net.source[cell] = 1.0 / resistance;
+        net.diagonal[cell] += net.source[cell];
+      }
+      if(line == size - 1)
+      {
+        net.sink[cell] = 1.0 / resistance;
+        net.diagonal[cell] += net.sink[cell];
+      }
+    }
+  }
+
+  static void multiply(const network& net, const vector<double>& vector_in, vector<double>& vector_out)
+  {
+    for(size_t cell = 0; cell < vector_in.size(); ++cell)
+    {
+      double value = net.diagonal[cell] * vector_in[cell];
+      for(int k = 0; k < 6; ++k)
+        if(net.conductance[cell][k] != 0.0)
+          value -= net.conductance[cell][k] * vector_in[net.neighbors[cell][k]];
+      vector_out[cell] = value;
+    }
+  }
+
+  static void precondition(network& net)
+  {
+    for(size_t cell = 0; cell < net.residual.size(); ++cell)
+      net.preconditioned[cell] = net.diagonal[cell] > 0.0 ? net.residual[cell] / net.diagonal[cell] : 0.0;
+  }
+
+  static double dot(const vector<double>& left, const vector<double>& right)
+  {
+    double result = 0.0;
+    for(size_t i = 0; i < left.size(); ++i)
+      result += left[i] * right[i];
+    return result;
+  }
+
+  static int solve(network& net)
+  {
+    // residual = source - A * voltage, voltage is solution of previous position
+    multiply(net, net.voltage, net.product);
+    for(size_t i = 0; i < net.voltage.size(); ++i)
+      net.residual[i] = net.source[i] - net.product[i];
+
+    const auto tolerance = solver_tolerance * solver_tolerance * std::max(dot(net.source, net.source), 1.0);
+    precondition(net);
+    net.direction = net.preconditioned;
+    auto residual_dot = dot(net.residual, net.preconditioned);
+
+    const int max_iterations = static_cast<int>(net.voltage.size()) * 2;
+    int iteration = 0;
+    for(; iteration < max_iterations && dot(net.residual, net.residual) > tolerance; ++iteration)
+    {
+      multiply(net, net.direction, net.product);
+      auto direction_dot = dot(net.direction, net.product);
+      if(direction_dot <= 0.0)
+        break;
+      auto alpha = residual_dot / direction_dot;
+      for(size_t i = 0; i < net.voltage.size(); ++i)
+      {
+        net.voltage[i] += alpha * net.direction[i];
+        net.residual[i] -= alpha * net.product[i];
+      }
+
+      precondition(net);
+      auto new_residual_dot = dot(net.residual, net.preconditioned);
+      auto beta = new_residual_dot / residual_dot;
+      residual_dot = new_residual_dot;
+      for(size_t i = 0; i < net.direction.size(); ++i)
+        net.direction[i] = net.preconditioned[i] + beta * net.direction[i];
+    }
+    return iteration;
+  }
+
+  static void collect_cell_current(const network& net, vector<double>& out_cell_current)
+  {
+    out_cell_current.assign(net.voltage.size(), 0.0);
+    for(size_t cell = 0; cell < net.voltage.size(); ++cell)
+    {
+      // every current flows in and out of the cell, so half of sum of absolute currents
+      double current = net.source[cell] * std::abs(1.0 - net.voltage[cell]);
+      for(int k = 0; k < 6; ++k)
+        if(net.conductance[cell][k] != 0.0)
+          current += net.conductance[cell][k] * std::abs(net.voltage[cell] - net.voltage[net.neighbors[cell][k]]);
+      current += net.sink[cell] * std::abs(net.voltage[cell]);
+      out_cell_current[cell] = current * 0.5;
+    }
+  }
+
+  static constexpr double own_stone_resistance = 0.01;
+  static constexpr double solver_tolerance = 1e-6;
+  static constexpr double min_current = 1e-6;
+
+  array<network, 2> networks;
+};
+
+// H-search of virtual connections for one color.
+// Full connection between two nodes (cells or edges) can not be broken by opponent even if he moves first,
+// semi connection becomes full if color moves to its key cell. Carrier is the set of empty cells connection needs.
+// Rules: AND - two full connections through common node give full connection if node is own stone
+// and semi connection if it is empty cell; OR - semi connections without common cell in carriers give full connection.
+// Connections kept between moves, new ones found from queue of changed connections only.
+class virtual_connections
+{
+public:
+  explicit virtual_connections(Color color)
+  : color(color) {}
+
+  //! update connections to position, connections that are not broken by moves since last update are kept
+  void update(const hex_board& board)
+  {
+    const auto cell_count = board.get_size() * board.get_size();
+    if(board.get_size() != size)
+    {
+      rebuild(board);
+      return;
+    }
+
+    own_moves.clear();
+    for(int cell = 0; cell < cell_count; ++cell)
+    {
+      auto new_color = board.get_cell(cell).color;
+      if(new_color == cell_colors[cell])
+        continue;
+      // only stones placed on empty cells can be updated incrementally
+      if(cell_colors[cell] != Color::none)
+      {
+        rebuild(board);
+        return;
+      }
+      cell_colors[cell] = new_color;
+      if(new_color == color)
+        own_moves.push_back(cell);
+      else
+        remove_broken(cell);
+    }
+
+    for(auto cell : own_moves)
+      add_own_stone(cell);
+    run_search();
+  }
+
+  //! color already connects own edges, whatever opponent does
+  bool has_edge_connection() const
+  {
+    return !get_fulls(first_edge(), second_edge()).empty();
+  }
+
+  //! cells where opponent must play to stop color from connecting its edges,
+  //! no value if color has no edge connection threat or if it can not be stopped by one move
+  optional<cell_set> must_play_region() const
+  {
+    const auto& fulls = get_fulls(first_edge(), second_edge());
+    const auto& semis = get_semis(first_edge(), second_edge());
+    if(fulls.empty() && semis.empty())
+      return std::nullopt;
+
+    cell_set region;
+    region.set();
+    for(const auto& carrier : fulls)
+      region &= carrier;
+    for(const auto& semi : semis)
+      region &= semi.carrier;
+
+    if(region.none())
+      return std::nullopt;
+    return region;
+  }
+
+private:
+  struct semi_connection
+  {
+    cell_set carrier;
+    int key;
+  };
+
+  // list with fixed capacity, lists of pairs are taken from pools and never allocate themselves
+  template<typename T, size_t capacity>
+  class bounded_list
+  {
+  public:
+    const T* begin() const { return items.data(); }
+    const T* end() const { return items.data() + count; }
+    T* begin() { return items.data(); }
+    T* end() { return items.data() + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool is_full() const { return count == capacity; }
+    void push_back(const T& item) { items[count++] = item; }
+    void clear() { count = 0; }
+
+    template<typename Predicate>
+    void erase_if(Predicate predicate) { count = static_cast<size_t>(std::remove_if(begin(), end(), predicate) - begin()); }
+
+  private:
+    array<T, capacity> items;
+    size_t count = 0;
+  };
+
+  // bounds that keep search fast, connections with big carriers are rare useful
+  static constexpr size_t max_full_per_pair = 4;
+  static constexpr size_t max_semi_per_pair = 8;
+  static constexpr size_t max_carrier_size = 24;
+  // room of queue for connections of touched nodes in dense positions, it grows only beyond that
+  static constexpr int pending_per_node = 256;
+
+  using full_list = bounded_list<cell_set, max_full_per_pair>;
+  using semi_list = bounded_list<semi_connection, max_semi_per_pair>;
+
+  // most node pairs have no connections, so pair keeps only indexes of its lists in pools, -1 for no list
+  struct pair_connections
+  {
+    int full = -1;
+    int semi = -1;
+  };
+
+  // lists of removed connections go to free list and are reused.
+  // Pair has at most one list of every kind, so pool reserved for all pairs never grows,
+  // big reservation is mapped lazily and pages of lists that are never taken cost no memory
+  template<typename List>
+  struct list_pool
+  {
+    int take()
+    {
+      if(!free_lists.empty())
+      {
+        auto index = free_lists.back();
+        free_lists.pop_back();
+        return index;
+      }
+      assert(lists.size() < lists.capacity());
+      lists.emplace_back();
+      return static_cast<int>(lists.size() - 1);
+    }
+
+    void release(int& index)
+    {
+      if(index == -1)
+        return;
+      lists[index].clear();
+      free_lists.push_back(index);
+      index = -1;
+    }
+
+    void clear(size_t reserved_count)
+    {
+      lists.clear();
+      free_lists.clear();
+      lists.reserve(reserved_count);
+      free_lists.reserve(lists.capacity());
+    }
+
+    vector<List> lists;
+    vector<int> free_lists;
+  };
+
+  struct pending_connection
+  {
+    int from;
+    int to;
+    cell_set carrier;
+  };
+
+  int first_edge() const { return cell_count; }
+  int second_edge() const { return cell_count + 1; }
+  bool is_edge(int node) const { return node >= cell_count; }
+
+  // cells of opponent color are not nodes, edges are always nodes
+  bool is_node(int node) const
+  {
+    return is_edge(node) || cell_colors[node] == Color::none || cell_colors[node] == color;
+  }
+
+  pair_connections& get_pair(int from, int to)
+  {
+    if(from > to)
+      std::swap(from, to);
+    return connections[from * node_count + to];
+  }
+
+  const pair_connections& get_pair(int from, int to) const
+  {
+    if(from > to)
+      std::swap(from, to);
+    return connections[from * node_count + to];
+  }
+
+  const full_list& get_fulls(int from, int to) const
+  {
+    static const full_list no_connections {};
+    auto index = get_pair(from, to).full;
+    return index == -1 ? no_connections : full_pool.lists[index];
+  }
+
+  const semi_list& get_semis(int from, int to) const
+  {
+    static const semi_list no_connections {};
+    auto index = get_pair(from, to).semi;
+    return index == -1 ? no_connections : semi_pool.lists[index];
+  }
+
+  // list of pair for change, taken from pool if pair had no list
+  full_list& change_fulls(pair_connections& pair)
+  {
+    if(pair.full == -1)
+      pair.full = full_pool.take();
+    return full_pool.lists[pair.full];
+  }
+
+  semi_list& change_semis(pair_connections& pair)
+  {
+    if(pair.semi == -1)
+      pair.semi = semi_pool.take();
+    return semi_pool.lists[pair.semi];
+  }
+
+  void rebuild(const hex_board& board)
+  {
+    size = board.get_size();
+    cell_count = size * size;
+    node_count = cell_count + 2;
+    connections.assign(node_count * node_count, pair_connections());
+    const auto pair_count = static_cast<size_t>(node_count) * (node_count - 1) / 2;
+    full_pool.clear(pair_count);
+    semi_pool.clear(pair_count);
+    cell_colors.resize(cell_count);
+    pending.resize(std::max(pending.size(), static_cast<size_t>(node_count) * pending_per_node));
+    pending_head = pending_tail = 0;
+    own_moves.reserve(cell_count);
+    touched_nodes.reserve(node_count);
+
+    for(int cell = 0; cell < cell_count; ++cell)
+      cell_colors[cell] = board.get_cell(cell).color;
+
+    // adjacent nodes are connected with empty carrier
+    for(int cell = 0; cell < cell_count; ++cell)
+    {
+      if(!is_node(cell))
+        continue;
+      for(auto neighbor : board.get_neighbors(cell))
+        if(neighbor > cell && is_node(neighbor))
+          add_full(cell, neighbor, cell_set());
+
+      // blue edges are left and right columns, red edges are top and bottom rows
+      auto pos = board.to_position(cell);
+      auto line = color == Color::blue ? pos.column : pos.row;
+      if(line == 0)
+        add_full(cell, first_edge(), cell_set());
+      if(line == size - 1)
+        add_full(cell, second_edge(), cell_set());
+    }
+
+    run_search();
+  }
+
+  // opponent stone breaks every connection that used the cell,
+  // connections of touched pairs could be skipped before as redundant, so search them again from both ends
+  void remove_broken(int cell)
+  {
+    for(int node = 0; node < node_count; ++node)
+    {
+      auto& pair = get_pair(cell, node);
+      full_pool.release(pair.full);
+      semi_pool.release(pair.semi);
+    }
+
+    touched_nodes.assign(node_count, 0);
+    for(int from = 0; from < node_count; ++from)
+    {
+      for(int to = from + 1; to < node_count; ++to)
+      {
+        auto& pair = get_pair(from, to);
+        if(pair.full == -1 && pair.semi == -1)
+          continue;
+        auto& fulls = change_fulls(pair);
+        auto& semis = change_semis(pair);
+        auto connection_count = fulls.size() + semis.size();
+        fulls.erase_if([=] (const cell_set& carrier) { return carrier.test(cell); });
+        semis.erase_if([=] (const semi_connection& semi) { return semi.carrier.test(cell); });
+        if(fulls.size() + semis.size() != connection_count)
+          touched_nodes[from] = touched_nodes[to] = 1;
+        if(fulls.empty())
+          full_pool.release(pair.full);
+        if(semis.empty())
+          semi_pool.release(pair.semi);
+      }
+    }
+
+    for(int node = 0; node < node_count; ++node)
+      if(touched_nodes[node])
+        queue_connections_of(node);
+  }
+
+  void queue_connections_of(int node)
+  {
+    for(int other = 0; other < node_count; ++other)
+      if(other != node)
+        for(const auto& carrier : get_fulls(node, other))
+          push_pending(node, other, carrier);
+  }
+
+  // own stone completes semi connections with key in the cell and becomes middle node of new AND combinations
+  void add_own_stone(int cell)
+  {
+    for(int from = 0; from < node_count; ++from)
+    {
+      for(int to = from + 1; to < node_count; ++to)
+      {
+        auto& pair = get_pair(from, to);
+        if(pair.full != -1)
+          for(auto& carrier : full_pool.lists[pair.full])
+            carrier.reset(cell);
+        if(pair.semi == -1)
+          continue;
+        // copy, semi connections are added back one by one
+        auto semis = semi_pool.lists[pair.semi];
+        semi_pool.release(pair.semi);
+        for(auto& semi : semis)
+        {
+          semi.carrier.reset(cell);
+          if(semi.key == cell)
+            add_full(from, to, semi.carrier);
+          else
+            add_semi(from, to, semi.carrier, semi.key);
+        }
+      }
+    }
+
+    queue_connections_of(cell);
+  }
+
+  void run_search()
+  {
+    while(pending_head != pending_tail)
+    {
+      auto next = pending[pending_head++ % pending.size()];
+
+      // AND rule with new connection on any side of middle node
+      for(auto [middle, from] : {pair<int, int>{next.to, next.from}, pair<int, int>{next.from, next.to}})
+      {
+        if(is_edge(middle))
+          continue;
+        for(int to = 0; to < node_count; ++to)
+        {
+          if(to == middle || to == from || !is_node(to))
+            continue;
+          // copy, adding connections can change the list
+          auto fulls = get_fulls(middle, to);
+          for(const auto& carrier : fulls)
+            combine_and(from, to, middle, next.carrier, carrier);
+        }
+      }
+    }
+  }
+
+  void push_pending(int from, int to, const cell_set& carrier)
+  {
+    if(pending_tail - pending_head == pending.size())
+      grow_pending();
+    pending[pending_tail++ % pending.size()] = pending_connection{from, to, carrier};
+  }
+
+  // queue keeps grown size for later searches, so it grows only on new high water mark
+  void grow_pending()
+  {
+    vector<pending_connection> grown(pending.size() * 2);
+    for(auto index = pending_head; index != pending_tail; ++index)
+      grown[index - pending_head] = pending[index % pending.size()];
+    pending_tail -= pending_head;
+    pending_head = 0;
+    pending.swap(grown);
+  }
+
+  void combine_and(int from, int to, int middle, const cell_set& first, const cell_set& second)
+  {
+    if((first & second).any())
+      return;
+    if((!is_edge(from) && second.test(from)) || (!is_edge(to) && first.test(to)))
+      return;
+
+    auto carrier = first | second;
+    if(carrier.test(middle))
+      return;
+    if(cell_colors[middle] == color)
+      add_full(from, to, carrier);
+    else
+    {
+      carrier.set(middle);
+      add_semi(from, to, carrier, middle);
+    }
+  }
+
+  void add_full(int from, int to, const cell_set& carrier)
+  {
+    if(carrier.count() > max_carrier_size)
+      return;
+    auto& pair = get_pair(from, to);
+    // skip if some existing connection needs less cells
+    for(const auto& existing : get_fulls(from, to))
+      if((existing & carrier) == existing)
+        return;
+    auto& fulls = change_fulls(pair);
+    fulls.erase_if([&] (const cell_set& existing) { return (existing & carrier) == carrier; });
+    if(fulls.is_full())
+      return;
+
+    fulls.push_back(carrier);
+    push_pending(from, to, carrier);
+  }
+
+  void add_semi(int from, int to, const cell_set& carrier, int key)
+  {
+    if(carrier.count() > max_carrier_size)
+      return;
+    auto& pair = get_pair(from, to);
+    // semi connection is useless when full connection exists inside of its carrier
+    for(const auto& existing : get_fulls(from, to))
+      if((existing & carrier) == existing)
+        return;
+    for(const auto& existing : get_semis(from, to))
+      if((existing.carrier & carrier) == existing.carrier)
+        return;
+    auto& semis = change_semis(pair);
+    if(semis.is_full())
+      return;
+    semis.push_back(semi_connection{carrier, key});
+
+    // OR rule, collect semi connections until their carriers have no common cell
+    auto intersection = carrier;
+    cell_set joined = carrier;
+    for(const auto& semi : semis)
+    {
+      auto reduced = intersection & semi.carrier;
+      if(reduced == intersection)
+        continue;
+      intersection = reduced;
+      joined |= semi.carrier;
+      if(intersection.none())
+      {
+        add_full(from, to, joined);
+        return;
+      }
+    }
+  }
+
+  Color color;
+  int size = 0;
+  int cell_count = 0;
+  int node_count = 0;
+  vector<Color> cell_colors;
+  // connections of every node pair, indexed by from * node_count + to where from < to
+  vector<pair_connections> connections;
+  list_pool<full_list> full_pool;
+  list_pool<semi_list> semi_pool;
+  // ring queue of new connections, sized on rebuild, head and tail count pushed and taken connections
+  vector<pending_connection> pending;
+  size_t pending_head = 0;
+  size_t pending_tail = 0;
+  // buffers of update, kept to not allocate on every move
+  vector<int> own_moves;
+  vector<char> touched_nodes;
+};
+
+// Local pattern policy, weight of move is product of weights of 6 neighbors pattern
+// and 12 cells pattern (hashed) around the cell, separate weights for every color.
+// Weights kept as log2 values quantized to 1/16, file contains only not zero weights:
+// "HXPT", version, bits of large table, then for every color and table - count and (index, weight) records
+class pattern_policy
+{
+public:
+  static constexpr int small_pattern_bits = 12;
+  static constexpr int large_pattern_bits = 16;
+  static constexpr int weight_scale = 16;
+
+  pattern_policy()
+  {
+    for(auto& weights : small_weights)
+      weights.assign(1 << small_pattern_bits, 0);
+    for(auto& weights : large_weights)
+      weights.assign(1 << large_pattern_bits, 0);
+    for(size_t i = 0; i < exp_table.size(); ++i)
+      exp_table[i] = std::exp2((static_cast<int>(i) - exp_table_offset) / static_cast<double>(weight_scale));
+  }
+
+  static int small_pattern_index(uint32_t pattern) { return pattern & ((1u << small_pattern_bits) - 1); }
+  static int large_pattern_index(uint32_t pattern) { return (pattern * 0x9E3779B1u) >> (32 - large_pattern_bits); }
+
+  //! weight of move for color, empty cells only
+  double move_weight(const hex_board& board, int cell_index, Color color) const
+  {
+    auto pattern = board.get_cell(cell_index).pattern;
+    auto index = color_index(color);
+    int log_weight = small_weights[index][small_pattern_index(pattern)] + large_weights[index][large_pattern_index(pattern)];
+    return exp_table[log_weight + exp_table_offset];
+  }
+
+  //! probabilities of moves for color for every cell, 0 for occupied cells
+  void move_priors(const hex_board& board, Color color, vector<double>& out_priors) const
+  {
+    const auto cell_count = board.get_size() * board.get_size();
+    out_priors.assign(cell_count, 0.0);
+    double sum = 0.0;
+    for(int cell_index = 0; cell_index < cell_count; ++cell_index)
+    {
+      if(board.get_cell(cell_index).color != Color::none)
+        continue;
+      out_priors[cell_index] = move_weight(board, cell_index, color);
+      sum += out_priors[cell_index];
+    }
+    if(sum > 0.0)
+      for(auto& prior : out_priors)
+        prior /= sum;
+  }
+
+  void set_small_weight(Color color, int index, int8_t log_weight) { small_weights[color_index(color)][index] = log_weight; }
+  void set_large_weight(Color color, int index, int8_t log_weight) { large_weights[color_index(color)][index] = log_weight; }
+
+  bool load(const string& path)
+  {
+    std::ifstream file(path, std::ios::binary);
+    char magic[4] = {};
+    file.read(magic, sizeof(magic));
+    auto version = file.get();
+    auto large_bits = file.get();
+    if(!file || string(magic, sizeof(magic)) != "HXPT" || version != 1 || large_bits != large_pattern_bits)
+      return false;
+
+    for(int color = 0; color < 2; ++color)
+    {
+      for(auto table : {&small_weights[color], &large_weights[color]})
+      {
+        std::fill(table->begin(), table->end(), 0);
+        uint32_t count = read_value<uint32_t>(file);
+        for(uint32_t i = 0; i < count && file; ++i)
+        {
+          auto index = read_value<uint16_t>(file);
+          auto log_weight = read_value<int8_t>(file);
+          if(index >= table->size())
+            return false;
+          (*table)[index] = log_weight;
+        }
+      }
+    }
+    return static_cast<bool>(file);
+  }
+
+  bool save(const string& path) const
+  {
+    std::ofstream file(path, std::ios::binary);
+    file.write("HXPT", 4);
+    file.put(1);
+    file.put(large_pattern_bits);
+    for(int color = 0; color < 2; ++color)
+    {
+      for(auto table : {&small_weights[color], &large_weights[color]})
+      {
+        auto count = static_cast<uint32_t>(table->size() - std::count(table->begin(), table->end(), 0));
+        write_value(file, count);
+        for(size_t index = 0; index < table->size(); ++index)
+        {
+          if((*table)[index] == 0)
+            continue;
+          write_value(file, static_cast<uint16_t>(index));
+          write_value(file, (*table)[index]);
+        }
+      }
+    }
+    return static_cast<bool>(file);
+  }
+
+private:
+  static int color_index(Color color) { return color == Color::red ? 0 : 1; }
+
+  // little endian on every platform
+  template<typename T>
+  static T read_value(std::istream& stream)
+  {
+    std::make_unsigned_t<T> value = 0;
+    for(size_t i = 0; i < sizeof(T); ++i)
+      value |= static_cast<std::make_unsigned_t<T>>(static_cast<unsigned char>(stream.get())) << (i * 8);
+    return static_cast<T>(value);
+  }
+
+  template<typename T>
+  static void write_value(std::ostream& stream, T value)
+  {
+    auto bits = static_cast<std::make_unsigned_t<T>>(value);
+    for(size_t i = 0; i < sizeof(T); ++i)
+      stream.put(static_cast<char>((bits >> (i * 8)) & 0xFF));
+  }
+
+  array<vector<int8_t>, 2> small_weights;
+  array<vector<int8_t>, 2> large_weights;
+  // 2^(w/16) for every possible sum of two int8_t weights
+  static constexpr int exp_table_offset = 256;
+  array<double, 2 * exp_table_offset> exp_table;
+};
+
+// Offline training of pattern policy from moves of engine games,
+// weight of pattern is how often move with it was played compared to how often it was possible
+class pattern_trainer
+{
+public:
+  pattern_trainer()
+  {
+    for(auto& counts : small_counts)
+      counts.assign(1 << pattern_policy::small_pattern_bits, pattern_count());
+  }
+
+  void add_move(const hex_board& board, int played_cell, Color color)
+  {
+    auto index = color == Color::red ? 0 : 1;
+    const auto cell_count = board.get_size() * board.get_size();
+    for(int cell_index = 0; cell_index < cell_count; ++cell_index)
+    {
+      if(board.get_cell(cell_index).color != Color::none)
+        continue;
+      auto pattern = board.get_cell(cell_index).pattern;
+      auto played = cell_index == played_cell ? 1u : 0u;
+      auto& small = small_counts[index][pattern_policy::small_pattern_index(pattern)];
+      small.seen++;
+      small.played += played;
+      auto& large = large_counts[index][pattern];
+      large.seen++;
+      large.played += played;
+      totals[index].seen++;
+      totals[index].played += played;
+    }
+  }
+
+  pattern_policy build_policy() const
+  {
+    pattern_policy policy;
+    for(int index = 0; index < 2; ++index)
+    {
+      auto color = index == 0 ? Color::red : Color::blue;
+      if(totals[index].seen == 0)
+        continue;
+      const double base_rate = static_cast<double>(totals[index].played) / totals[index].seen;
+
+      for(size_t small_index = 0; small_index < small_counts[index].size(); ++small_index)
+      {
+        auto rate = smoothed_rate(small_counts[index][small_index], base_rate);
+        policy.set_small_weight(color, static_cast<int>(small_index), quantize(rate / base_rate));
+      }
+
+      // large pattern weight corrects weight of its small pattern, on hash collision more frequent pattern wins
+      vector<uint32_t> slot_seen(1 << pattern_policy::large_pattern_bits, 0);
+      for(const auto& [pattern, count] : large_counts[index])
+      {
+        auto slot = pattern_policy::large_pattern_index(pattern);
+        if(count.seen <= slot_seen[slot])
+          continue;
+        slot_seen[slot] = count.seen;
+        auto small_rate = smoothed_rate(small_counts[index][pattern_policy::small_pattern_index(pattern)], base_rate);
+        auto rate = smoothed_rate(count, small_rate);
+        policy.set_large_weight(color, slot, quantize(rate / small_rate));
+      }
+    }
+    return policy;
+  }
+
+private:
+  struct pattern_count
+  {
+    uint32_t played = 0;
+    uint32_t seen = 0;
+  };
+
+  // rare patterns pulled to prior rate
+  static double smoothed_rate(const pattern_count& count, double prior_rate)
+  {
+    constexpr double prior_count = 4.0;
+    return (count.played + prior_count * prior_rate) / (count.seen + prior_count);
+  }
+
+  static int8_t quantize(double weight)
+  {
+    auto value = std::lround(std::log2(weight) * pattern_policy::weight_scale);
+    return static_cast<int8_t>(std::clamp<long>(value, -128, 127));
+  }
+
+  array<vector<pattern_count>, 2> small_counts;
+  array<unordered_map<uint32_t, pattern_count>, 2> large_counts;
+  array<pattern_count, 2> totals;
+};
+
+// Sampling of moves by policy weights in O(log n) with Fenwick tree for every color,
+// after move only weights of cells which patterns include the moved cell are updated
+class policy_sampler
+{
+public:
+  void reset(const hex_board& board, const pattern_policy& new_policy)
+  {
+    policy = &new_policy;
+    cell_count = board.get_size() * board.get_size();
+    for(int index = 0; index < 2; ++index)
+    {
+      auto color = index == 0 ? Color::red : Color::blue;
+      weights[index].assign(cell_count, 0.0);
+      trees[index].assign(cell_count + 1, 0.0);
+      for(int cell_index = 0; cell_index < cell_count; ++cell_index)
+        if(board.get_cell(cell_index).color == Color::none)
+          set_weight(index, cell_index, policy->move_weight(board, cell_index, color));
+    }
+  }
+
+  //! copy state of other sampler without allocations
+  void assign(const policy_sampler& other)
+  {
+    policy = other.policy;
+    cell_count = other.cell_count;
+    for(int index = 0; index < 2; ++index)
+    {
+      weights[index].assign(other.weights[index].begin(), other.weights[index].end());
+      trees[index].assign(other.trees[index].begin(), other.trees[index].end());
+    }
+  }
+
+  //! call after board.mark_cell of cell_index
+  void play(const hex_board& board, int cell_index)
+  {
+    for(int index = 0; index < 2; ++index)
+      set_weight(index, cell_index, 0.0);
+
+    for(auto cell : board.get_pattern_cells(cell_index))
+    {
+      if(cell == -1 || board.get_cell(cell).color != Color::none)
+        continue;
+      set_weight(0, cell, policy->move_weight(board, cell, Color::red));
+      set_weight(1, cell, policy->move_weight(board, cell, Color::blue));
+    }
+  }
+
+  //! random empty cell with probability proportional to its weight, -1 if no empty cells
+  int sample(Color color, minstd_rand& random) const
+  {
+    auto index = color == Color::red ? 0 : 1;
+    const auto& tree = trees[index];
+    // sums accumulate rounding errors, retry if landed on occupied cell
+    for(int attempt = 0; attempt < 4; ++attempt)
+    {
+      auto total = prefix_sum(tree, cell_count);
+      if(total <= 0.0)
+        return -1;
+      auto target = std::uniform_real_distribution<double>(0.0, total)(random);
+      int position = 0;
+      for(int step = highest_bit(cell_count); step > 0; step >>= 1)
+      {
+        if(position + step <= cell_count && tree[position + step] <= target)
+        {
+          position += step;
+          target -= tree[position];
+        }
+      }
+      if(position < cell_count && weights[index][position] > 0.0)
+        return position;
+    }
+    auto best = std::max_element(weights[index].begin(), weights[index].end());
+    return *best > 0.0 ? static_cast<int>(best - weights[index].begin()) : -1;
+  }
+
+private:
+  void set_weight(int index, int cell_index, double weight)
+  {
+    auto delta = weight - weights[index][cell_index];
+    weights[index][cell_index] = weight;
+    for(int i = cell_index + 1; i <= cell_count; i += i & -i)
+      trees[index][i] += delta;
+  }
+
+  static double prefix_sum(const vector<double>& tree, int count)
+  {
+    double sum = 0.0;
+    for(int i = count; i > 0; i -= i & -i)
+      sum += tree[i];
+    return sum;
+  }
+
+  static int highest_bit(int value)
+  {
+    int bit = 1;
+    while(bit * 2 <= value)
+      bit *= 2;
+    return bit;
+  }
+
+  const pattern_policy* policy = nullptr;
+  int cell_count = 0;
+  array<vector<double>, 2> weights;
+  array<vector<double>, 2> trees;
+};
+
+// Read only view of whole file, mapped to memory where mmap is available and read to buffer on other platforms
+class mapped_file
+{
+public:
+  mapped_file() = default;
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+  ~mapped_file() { close(); }
+
+  bool open(const string& path)
+  {
+    close();
+#if HEX_HAS_MMAP
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if(descriptor == -1)
+      return false;
+    struct stat file_stat;
+    if(fstat(descriptor, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+      length = static_cast<size_t>(file_stat.st_size);
+      mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      if(mapping == MAP_FAILED)
+      {
+        mapping = nullptr;
+        length = 0;
+      }
+    }
+    ::close(descriptor);
+    return mapping != nullptr;
+#else
+    std::ifstream file(path, std::ios::binary);
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    length = buffer.size();
+    return file.good() || file.eof();
+#endif
+  }
+
+  void close()
+  {
+#if HEX_HAS_MMAP
+    if(mapping != nullptr)
+      munmap(mapping, length);
+    mapping = nullptr;
+#else
+    buffer.clear();
+#endif
+    length = 0;
+  }
+
+  const uint8_t* data() const
+  {
+#if HEX_HAS_MMAP
+    return static_cast<const uint8_t*>(mapping);
+#else
+    return buffer.data();
+#endif
+  }
+
+  size_t size() const { return length; }
+
+private:
+  size_t length = 0;
+#if HEX_HAS_MMAP
+  void* mapping = nullptr;
+#else
+  vector<uint8_t> buffer;
+#endif
+};
+
+// Position from self play game with what search thought about it and how game ended.
+// Packed record: size, side to move, result, cells by 2 bits (4 cells in byte), policy by byte for every cell
+struct training_record
+{
+  int size = 0;
+  Color side_to_move = Color::none;
+  //! result of game for side to move, 1 - won, -1 - lost
+  int result = 0;
+  vector<Color> cells;
+  //! visit distribution of tree search root over cells, visits of move * 255 / visits of all moves
+  vector<uint8_t> policy;
+
+  static size_t packed_size(int board_size) { return 3 + (board_size * board_size + 3) / 4 + board_size * board_size; }
+
+  void pack(vector<uint8_t>& out) const
+  {
+    const auto cell_count = size * size;
+    out.push_back(static_cast<uint8_t>(size));
+    out.push_back(static_cast<uint8_t>(side_to_move));
+    out.push_back(static_cast<uint8_t>(static_cast<int8_t>(result)));
+    for(int i = 0; i < cell_count; i += 4)
+    {
+      uint8_t packed = 0;
+      for(int j = 0; j < 4 && i + j < cell_count; ++j)
+        packed |= static_cast<uint8_t>(cells[i + j]) << (j * 2);
+      out.push_back(packed);
+    }
+    out.insert(out.end(), policy.begin(), policy.end());
+  }
+
+  //! read record from offset and move offset to next record, false if data is broken or ended
+  bool unpack(const uint8_t* data, size_t length, size_t& offset)
+  {
+    if(offset >= length)
+      return false;
+    auto board_size = data[offset];
+    if(board_size == 0 || board_size > max_board_size || offset + packed_size(board_size) > length)
+      return false;
+
+    const auto cell_count = board_size * board_size;
+    auto ptr = data + offset;
+    size = board_size;
+    side_to_move = static_cast<Color>(ptr[1]);
+    result = static_cast<int8_t>(ptr[2]);
+    ptr += 3;
+    cells.resize(cell_count);
+    for(int i = 0; i < cell_count; ++i)
+      cells[i] = static_cast<Color>((ptr[i / 4] >> ((i % 4) * 2)) & 3);
+    ptr += (cell_count + 3) / 4;
+    policy.assign(ptr, ptr + cell_count);
+
+    offset += packed_size(board_size);
+    return true;
+  }
+};
+
+// Append only writer of training records to shard files "<prefix>-00000.hxtd", "<prefix>-00001.hxtd" ...
+// every run starts new shard. Records packed in caller thread and written to disk by background thread,
+// append never waits for disk, if writer is too far behind record is dropped and counted.
+class training_writer
+{
+public:
+  training_writer(string path_prefix, size_t records_per_shard)
+  : path_prefix(std::move(path_prefix))
+  , records_per_shard(std::max<size_t>(records_per_shard, 1))
+  , thread([this] { write_loop(); })
+  {
+  }
+
+  training_writer(const training_writer&) = delete;
+  training_writer& operator=(const training_writer&) = delete;
+
+  ~training_writer()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    has_data.notify_one();
+    thread.join();
+  }
+
+  bool append(const training_record& record)
+  {
+    thread_local vector<uint8_t> packed;
+    packed.clear();
+    record.pack(packed);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(incoming.size() + packed.size() > max_pending_bytes)
+      {
+        dropped_count++;
+        return false;
+      }
+      incoming.insert(incoming.end(), packed.begin(), packed.end());
+      incoming_records++;
+    }
+    has_data.notify_one();
+    return true;
+  }
+
+  size_t get_dropped_count() const { return dropped_count; }
+
+private:
+  static constexpr size_t max_pending_bytes = 16 * 1024 * 1024;
+
+  void write_loop()
+  {
+    vector<uint8_t> batch;
+    while(true)
+    {
+      size_t batch_records = 0;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        has_data.wait(lock, [this] { return stopping || incoming_records > 0; });
+        if(incoming_records == 0 && stopping)
+          break;
+        // take all pending records at once, producers continue to fill empty buffer
+        batch.clear();
+        std::swap(batch, incoming);
+        batch_records = incoming_records;
+        incoming_records = 0;
+      }
+
+      // batch is split on record boundaries, so no shard gets more than records_per_shard records
+      size_t offset = 0;
+      while(batch_records > 0)
+      {
+        if(!shard.is_open() || shard_records >= records_per_shard)
+          open_next_shard();
+        auto begin = offset;
+        auto count = std::min(batch_records, records_per_shard - shard_records);
+        for(size_t i = 0; i < count; ++i)
+          offset += training_record::packed_size(batch[offset]);
+        shard.write(reinterpret_cast<const char*>(batch.data() + begin), static_cast<std::streamsize>(offset - begin));
+        shard_records += count;
+        batch_records -= count;
+      }
+      shard.flush();
+    }
+  }
+
+  void open_next_shard()
+  {
+    shard.close();
+    string path;
+    do
+    {
+      std::ostringstream name;
+      name<<path_prefix<<'-'<<std::setw(5)<<std::setfill('0')<<shard_index++<<".hxtd";
+      path = name.str();
+    }
+    while(std::filesystem::exists(path));
+    shard.open(path, std::ios::binary | std::ios::app);
+    shard_records = 0;
+  }
+
+  string path_prefix;
+  size_t records_per_shard;
+  std::mutex mutex;
+  std::condition_variable has_data;
+  vector<uint8_t> incoming;
+  size_t incoming_records = 0;
+  bool stopping = false;
+  std::atomic<size_t> dropped_count{0};
+  // used only by writer thread
+  std::ofstream shard;
+  size_t shard_records = 0;
+  int shard_index = 0;
+  std::thread thread;
+};
+
+// Stream of training records from shard files, every shard mapped to memory in turn
+class training_reader
+{
+public:
+  explicit training_reader(vector<string> shard_paths)
+  : shard_paths(std::move(shard_paths)) {}
+
+  bool next(training_record& out_record)
+  {
+    while(!out_record.unpack(file.data(), file.size(), offset))
+    {
+      if(next_shard >= shard_paths.size())
+        return false;
+      file.open(shard_paths[next_shard++]);
+      offset = 0;
+    }
+    return true;
+  }
+
+private:
+  vector<string> shard_paths;
+  size_t next_shard = 0;
+  mapped_file file;
+  size_t offset = 0;
+};
+
+// Unsigned LEB128, 7 bits of value in every byte and high bit set if more bytes follow
+inline void write_varint(vector<uint8_t>& out, uint64_t value)
+{
+  while(value >= 0x80)
+  {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+//! false if data ended before last byte of value
+inline bool read_varint(const uint8_t* data, size_t length, size_t& offset, uint64_t& value)
+{
+  value = 0;
+  for(int shift = 0; shift < 64 && offset < length; shift += 7)
+  {
+    auto byte = data[offset++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+// Whole game as list of moves, blue moves first and players alternate.
+// Packed record: varint length of rest of record, size, winner, varint length and bytes of blue and red names,
+// varint count of moves and varint cell index of every move
+struct game_record
+{
+  int size = 0;
+  Color winner = Color::none;
+  string blue_player;
+  string red_player;
+  vector<short> moves;
+
+  Color get_move_color(size_t move_index) const { return move_index % 2 == 0 ? Color::blue : Color::red; }
+
+  void pack(vector<uint8_t>& out) const
+  {
+    vector<uint8_t> body;
+    body.push_back(static_cast<uint8_t>(size));
+    body.push_back(static_cast<uint8_t>(winner));
+    for(const auto* name : {&blue_player, &red_player})
+    {
+      write_varint(body, name->size());
+      body.insert(body.end(), name->begin(), name->end());
+    }
+    write_varint(body, moves.size());
+    for(auto cell_index : moves)
+      write_varint(body, static_cast<uint64_t>(cell_index));
+
+    write_varint(out, body.size());
+    out.insert(out.end(), body.begin(), body.end());
+  }
+
+  //! read record from offset and move offset to next record, false if data is broken or ended
+  bool unpack(const uint8_t* data, size_t length, size_t& offset)
+  {
+    uint64_t body_length;
+    auto position = offset;
+    if(!read_varint(data, length, position, body_length) || body_length > length - position || body_length < 2)
+      return false;
+    auto end = position + body_length;
+
+    size = data[position];
+    winner = static_cast<Color>(data[position + 1] & 3);
+    position += 2;
+    if(size == 0 || size > max_board_size)
+      return false;
+    for(auto* name : {&blue_player, &red_player})
+    {
+      uint64_t name_length;
+      if(!read_varint(data, end, position, name_length) || name_length > end - position)
+        return false;
+      name->assign(reinterpret_cast<const char*>(data + position), name_length);
+      position += name_length;
+    }
+    uint64_t move_count;
+    if(!read_varint(data, end, position, move_count) || move_count > static_cast<uint64_t>(size * size))
+      return false;
+    moves.resize(move_count);
+    for(auto& cell_index : moves)
+    {
+      uint64_t value;
+      if(!read_varint(data, end, position, value) || value >= static_cast<uint64_t>(size * size))
+        return false;
+      cell_index = static_cast<short>(value);
+    }
+
+    offset = end;
+    return true;
+  }
+
+  //! game tree of SGF for hex (GM[11]), blue is black (B) and red is white (W), cells as "a1" column and row
+  string to_sgf() const
+  {
+    std::ostringstream out;
+    out<<"(;FF[4]GM[11]AP[hex_game]SZ["<<size<<"]";
+    out<<"PB["<<escape_sgf(blue_player)<<"]PW["<<escape_sgf(red_player)<<"]";
+    if(winner != Color::none)
+      out<<"RE["<<(winner == Color::blue ? "B+" : "W+")<<"]";
+    for(size_t move_index = 0; move_index < moves.size(); ++move_index)
+    {
+      out<<';'<<(get_move_color(move_index) == Color::blue ? 'B' : 'W')<<'[';
+      out<<static_cast<char>('a' + moves[move_index] % size)<<moves[move_index] / size + 1<<']';
+    }
+    out<<")\n";
+    return out.str();
+  }
+
+  //! read game tree from offset of SGF text and move offset after it, only main line of variations is read
+  bool from_sgf(const string& text, size_t& offset)
+  {
+    size = 0;
+    winner = Color::none;
+    blue_player.clear();
+    red_player.clear();
+    moves.clear();
+
+    offset = text.find('(', offset);
+    if(offset == string::npos)
+      return false;
+    offset++;
+
+    // first variation continues main line, main line ends when it is closed and other variations are skipped
+    int depth = 1, main_depth = 1;
+    bool main_ended = false;
+    while(offset < text.size() && depth > 0)
+    {
+      char symbol = text[offset];
+      if(symbol == '(')
+      {
+        depth++;
+        if(!main_ended && depth == main_depth + 1)
+          main_depth = depth;
+        offset++;
+      }
+      else if(symbol == ')')
+      {
+        main_ended = main_ended || depth == main_depth;
+        depth--;
+        offset++;
+      }
+      else if(std::isupper(static_cast<unsigned char>(symbol)))
+      {
+        auto name_end = offset;
+        while(name_end < text.size() && std::isupper(static_cast<unsigned char>(text[name_end])))
+          name_end++;
+        auto name = text.substr(offset, name_end - offset);
+        offset = name_end;
+        string value;
+        while(read_sgf_value(text, offset, value))
+          if(!main_ended && depth == main_depth && !apply_sgf_property(name, value))
+            return false;
+      }
+      else
+        offset++;
+    }
+    return depth == 0 && size > 0;
+  }
+
+private:
+  static string escape_sgf(const string& value)
+  {
+    string result;
+    for(auto symbol : value)
+    {
+      if(symbol == ']' || symbol == '\\')
+        result += '\\';
+      result += symbol;
+    }
+    return result;
+  }
+
+  static bool read_sgf_value(const string& text, size_t& offset, string& value)
+  {
+    auto start = offset;
+    while(start < text.size() && std::isspace(static_cast<unsigned char>(text[start])))
+      start++;
+    if(start >= text.size() || text[start] != '[')
+      return false;
+    value.clear();
+    for(offset = start + 1; offset < text.size() && text[offset] != ']'; ++offset)
+    {
+      if(text[offset] == '\\' && offset + 1 < text.size())
+        offset++;
+      value += text[offset];
+    }
+    offset++;
+    return true;
+  }
+
+  bool apply_sgf_property(const string& name, const string& value)
+  {
+    if(name == "SZ")
+    {
+      size = std::atoi(value.c_str());
+      return size > 0 && size <= max_board_size && moves.empty();
+    }
+    if(name == "PB")
+      blue_player = value;
+    else if(name == "PW")
+      red_player = value;
+    else if(name == "RE" && !value.empty())
+      winner = value[0] == 'B' ? Color::blue : value[0] == 'W' ? Color::red : Color::none;
+    else if(name == "B" || name == "W")
+    {
+      // size 11 is default of hex in SGF
+      if(size == 0)
+        size = 11;
+      auto color = name == "B" ? Color::blue : Color::red;
+      if(color != get_move_color(moves.size()) || value.size() < 2 || !std::islower(static_cast<unsigned char>(value[0])))
+        return false;
+      int column = value[0] - 'a';
+      int row = std::isdigit(static_cast<unsigned char>(value[1])) ? std::atoi(value.c_str() + 1) - 1 : value[1] - 'a';
+      if(column >= size || row < 0 || row >= size)
+        return false;
+      moves.push_back(static_cast<short>(row * size + column));
+    }
+    return true;
+  }
+};
+
+// Collection of games in one file "HXGM" with version, then packed game records.
+// File is mapped to memory and only lengths of records are read on open, games are unpacked on demand
+class game_collection
+{
+public:
+  bool open(const string& path)
+  {
+    offsets.clear();
+    if(!file.open(path) || file.size() < header_size || std::memcmp(file.data(), magic, 4) != 0 || file.data()[4] != version)
+      return false;
+
+    // partly written record at the end is ignored
+    size_t offset = header_size;
+    while(offset < file.size())
+    {
+      uint64_t body_length;
+      auto position = offset;
+      if(!read_varint(file.data(), file.size(), position, body_length) || body_length > file.size() - position)
+        break;
+      offsets.push_back(offset);
+      offset = position + body_length;
+    }
+    return true;
+  }
+
+  size_t size() const { return offsets.size(); }
+
+  bool get(size_t index, game_record& out_record) const
+  {
+    auto offset = offsets[index];
+    return out_record.unpack(file.data(), file.size(), offset);
+  }
+
+  //! play first moves of game on board, board gets size of game, false if game is broken
+  bool replay(size_t index, hex_board& board, size_t move_count = std::numeric_limits<size_t>::max()) const
+  {
+    thread_local game_record record;
+    if(!get(index, record))
+      return false;
+    if(board.get_size() != record.size)
+      board = hex_board(record.size);
+    else
+    {
+      for(int cell_index = 0; cell_index < record.size * record.size; ++cell_index)
+        if(board.get_cell(cell_index).color != Color::none)
+          board.mark_cell(cell_index, Color::none);
+    }
+
+    move_count = std::min(move_count, record.moves.size());
+    for(size_t move_index = 0; move_index < move_count; ++move_index)
+    {
+      auto cell_index = record.moves[move_index];
+      if(board.get_cell(cell_index).color != Color::none)
+        return false;
+      board.mark_cell(cell_index, record.get_move_color(move_index));
+    }
+    return true;
+  }
+
+  //! append game to collection file, file created with header if it does not exist
+  static bool append(const string& path, const game_record& record)
+  {
+    vector<uint8_t> packed;
+    if(!std::filesystem::exists(path))
+    {
+      packed.insert(packed.end(), magic, magic + 4);
+      packed.push_back(version);
+    }
+    record.pack(packed);
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    out.write(reinterpret_cast<const char*>(packed.data()), static_cast<std::streamsize>(packed.size()));
+    return out.good();
+  }
+
+private:
+  static constexpr char magic[4] = {'H', 'X', 'G', 'M'};
+  static constexpr uint8_t version = 1;
+  static constexpr size_t header_size = 5;
+
+  mapped_file file;
+  vector<size_t> offsets;
+};
+
+// Playout statistics shared by engine runs and processes on one host through file mapped to memory.
+// Entry keeps either statistics of position (playouts from the position) or statistics of move
+// (all moves as first playouts of parent position where mover took the cell), their keys never match.
+// Table of buckets with 4 entries, entry is two atomic words: statistics and key xor-ed with statistics,
+// so entry torn by two writers at once reads as a miss and no locks are needed.
+// Every open starts new generation, entries of old generations and with less visits are replaced first
+class position_cache
+{
+public:
+  struct statistics
+  {
+    uint32_t visits = 0;
+    //! playouts won by color that moved to position
+    uint32_t wins = 0;
+  };
+
+  position_cache() = default;
+  position_cache(const position_cache&) = delete;
+  position_cache& operator=(const position_cache&) = delete;
+  ~position_cache() { close(); }
+
+  //! open or create cache file, entry count of new file rounded up to whole buckets of power of 2
+  bool open(const string& path, size_t entry_count = default_entry_count)
+  {
+    close();
+#if HEX_HAS_MMAP
+    int descriptor = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if(descriptor == -1)
+      return false;
+    // processes that open the file at once wait while the first one creates header
+    flock(descriptor, LOCK_EX);
+    struct stat file_stat;
+    bool created = false;
+    if(fstat(descriptor, &file_stat) == 0 && file_stat.st_size == 0)
+    {
+      size_t count = 1;
+      while(count * bucket_size < entry_count)
+        count *= 2;
+      file_stat.st_size = static_cast<off_t>(sizeof(cache_header) + count * sizeof(bucket));
+      created = ftruncate(descriptor, file_stat.st_size) == 0;
+      if(!created)
+        file_stat.st_size = 0;
+    }
+
+    length = static_cast<size_t>(file_stat.st_size);
+    if(length > sizeof(cache_header))
+    {
+      mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+      if(mapping == MAP_FAILED)
+        mapping = nullptr;
+    }
+    if(mapping != nullptr)
+    {
+      auto header = static_cast<cache_header*>(mapping);
+      if(created)
+      {
+        std::memcpy(header->magic, magic, sizeof(magic));
+        header->version = version;
+        header->bucket_count = (length - sizeof(cache_header)) / sizeof(bucket);
+      }
+      if(std::memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != version
+         || sizeof(cache_header) + header->bucket_count * sizeof(bucket) != length
+         || (header->bucket_count & (header->bucket_count - 1)) != 0)
+      {
+        munmap(mapping, length);
+        mapping = nullptr;
+      }
+    }
+    flock(descriptor, LOCK_UN);
+    ::close(descriptor);
+
+    if(mapping == nullptr)
+    {
+      length = 0;
+      return false;
+    }
+    auto header = static_cast<cache_header*>(mapping);
+    buckets = reinterpret_cast<bucket*>(header + 1);
+    bucket_mask = header->bucket_count - 1;
+    generation = (header->generation.fetch_add(1, std::memory_order_relaxed) + 1) & generation_mask;
+    return true;
+#else
+    (void)path;
+    (void)entry_count;
+    return false;
+#endif
+  }
+
+  void close()
+  {
+#if HEX_HAS_MMAP
+    if(mapping != nullptr)
+      munmap(mapping, length);
+#endif
+    mapping = nullptr;
+    buckets = nullptr;
+    length = 0;
+  }
+
+  bool is_open() const { return mapping != nullptr; }
+
+  //! key of position with color that moved to it
+  static uint64_t make_key(uint64_t canonical_hash, Color moved_color)
+  {
+    return canonical_hash ^ zobrist_keys::side_key(moved_color);
+  }
+
+  //! key of all moves as first statistics of move, found by canonical hash of position after the move
+  static uint64_t make_move_key(uint64_t canonical_hash_after, Color moved_color)
+  {
+    return make_key(canonical_hash_after, moved_color) ^ zobrist_keys::move_key();
+  }
+
+  optional<statistics> find(uint64_t key) const
+  {
+    for(auto& item : buckets[key & bucket_mask].entries)
+    {
+      auto data = item.data.load(std::memory_order_relaxed);
+      if(data != 0 && (item.check.load(std::memory_order_relaxed) ^ data) == key)
+        return unpack(data);
+    }
+    return std::nullopt;
+  }
+
+  //! add playouts to statistics of position, position is stored if it is new
+  void add(uint64_t key, uint32_t visits, uint32_t wins)
+  {
+    if(visits == 0)
+      return;
+    auto& entries = buckets[key & bucket_mask].entries;
+    entry* target = nullptr;
+    statistics current;
+    uint64_t min_priority = std::numeric_limits<uint64_t>::max();
+    for(auto& item : entries)
+    {
+      auto data = item.data.load(std::memory_order_relaxed);
+      if(data != 0 && (item.check.load(std::memory_order_relaxed) ^ data) == key)
+      {
+        target = &item;
+        current = unpack(data);
+        break;
+      }
+      // every generation of age halves worth of entry
+      auto age = (generation - get_generation(data)) & generation_mask;
+      auto priority = data == 0 ? 0 : (static_cast<uint64_t>(unpack(data).visits) + 1) >> std::min<uint64_t>(age, 32);
+      if(priority < min_priority)
+      {
+        min_priority = priority;
+        target = &item;
+      }
+    }
+
+    uint64_t total_visits = uint64_t(current.visits) + visits;
+    uint64_t total_wins = uint64_t(current.wins) + wins;
+    // keep share of wins when counters are full
+    while(total_visits > max_count)
+    {
+      total_visits /= 2;
+      total_wins /= 2;
+    }
+    auto data = (total_visits << visits_shift) | (total_wins << wins_shift) | generation;
+    target->data.store(data, std::memory_order_relaxed);
+    target->check.store(key ^ data, std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr size_t bucket_size = 4;
+  static constexpr size_t default_entry_count = size_t(1) << 20;
+  // statistics word: generation in low 8 bits, then visits and wins by 28 bits,
+  // visits of stored entry are never zero, so zero word is empty entry
+  static constexpr uint64_t generation_mask = 0xff;
+  static constexpr int visits_shift = 8;
+  static constexpr int wins_shift = 36;
+  static constexpr uint64_t max_count = (uint64_t(1) << 28) - 1;
+  static constexpr char magic[4] = {'H', 'X', 'P', 'C'};
+  // version 1 kept statistics of moves under keys of positions
+  static constexpr uint32_t version = 2;
+
+  struct entry
+  {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+  };
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "cache entries are shared by processes");
+
+  struct alignas(64) bucket
+  {
+    entry entries[bucket_size];
+  };
+
+  struct alignas(64) cache_header
+  {
+    char magic[4];
+    uint32_t version;
+    uint64_t bucket_count;
+    std::atomic<uint32_t> generation;
+  };
+
+  static statistics unpack(uint64_t data)
+  {
+    statistics result;
+    result.visits = static_cast<uint32_t>((data >> visits_shift) & max_count);
+    result.wins = static_cast<uint32_t>((data >> wins_shift) & max_count);
+    return result;
+  }
+
+  static uint64_t get_generation(uint64_t data) { return data & generation_mask; }
+
+  void* mapping = nullptr;
+  size_t length = 0;
+  bucket* buckets = nullptr;
+  uint64_t bucket_mask = 0;
+  uint64_t generation = 0;
+};
+
+// Bump allocator of scratch arrays that live until reset, memory is kept between resets.
+// When arrays do not fit, arena takes new block and next reset joins all blocks to one of high water size,
+// so arena allocates only when use between resets grows past the largest one before
+class scratch_arena
+{
+public:
+  //! array of count values, not initialized, valid until reset
+  template<typename T>
+  T* allocate(size_t count)
+  {
+    static_assert(std::is_trivially_destructible<T>::value, "arena never calls destructors");
+    static_assert(alignof(T) <= alignof(std::max_align_t), "blocks are aligned only to max_align_t");
+    auto bytes = count * sizeof(T);
+    auto offset = (block_used + alignof(T) - 1) / alignof(T) * alignof(T);
+    if(blocks.empty() || offset + bytes > blocks.back().size)
+    {
+      auto size = std::max(bytes, blocks.empty() ? initial_block_size : blocks.back().size * 2);
+      blocks.push_back(block {std::make_unique<std::max_align_t[]>((size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)), size});
+      offset = 0;
+    }
+    block_used = offset + bytes;
+    total_used += bytes + alignof(T) - 1;
+    high_water = std::max(high_water, total_used);
+    return reinterpret_cast<T*>(reinterpret_cast<std::byte*>(blocks.back().memory.get()) + offset);
+  }
+
+  void reset()
+  {
+    if(blocks.size() > 1)
+    {
+      blocks.clear();
+      blocks.push_back(block {std::make_unique<std::max_align_t[]>(high_water / sizeof(std::max_align_t) + 1), high_water});
+    }
+    block_used = 0;
+    total_used = 0;
+  }
+
+private:
+  static constexpr size_t initial_block_size = 16 * 1024;
+
+  struct block
+  {
+    std::unique_ptr<std::max_align_t[]> memory;
+    size_t size;
+  };
+
+  vector<block> blocks;
+  size_t block_used = 0;
+  // bytes used since reset with room for alignment, enough for single block
+  size_t total_used = 0;
+  size_t high_water = 0;
+};
+
+// Abstract player base class for hex game player
+class base_player
+{
+  public:
+    explicit base_player(Color color)
+    : color(color) {}
+    
+    Color get_color() const { return color; }
+    void capture_cell(int cell_index) { captured_cells.push_back(cell_index); }
+    const vector<int>& get_captured_cells() const { return captured_cells; }
+
+    virtual position make_move(const hex_board& board) = 0;
+    
+  private:
+    Color color;
+    vector<int> captured_cells;
+};
+
+// Game rules for determine win and get path that player build
+class HexGameRules
+{
+public:
+
+  //! winner of position, checks do not allocate memory unless win path is requested
+  Color check_winner(const hex_board& board, vector<int>* out_win_path = nullptr) const
+  {
+    if(connects_edges(board, Color::blue, out_win_path))
+      return Color::blue;
+    if(connects_edges(board, Color::red, out_win_path))
+      return Color::red;
+    return Color::none;
+  }
+
+  bool is_winner(const hex_board& board, const base_player& player, vector<int>* out_win_path = nullptr)
+  {
+    // first get all hex cells on the player win side
+    auto captured_cells = player.get_captured_cells();
+    vector<int> one_side_cells;
+    vector<int> another_side_cells;
+    for(auto n_id : captured_cells)
+    {
+      auto indexes = board.to_position(n_id);
+      // get all blue cells on destination side from start to end
+      if(player.get_color() == Color::blue)
+      {
+        if(indexes.column == 0)
+          one_side_cells.push_back(n_id);
+        else if(indexes.column == board.get_size() - 1)
+          another_side_cells.push_back(n_id);
+      }
+      // get all red cells on destination side from start to end
+      else
+      {
+        if(indexes.row == 0)
+          one_side_cells.push_back(n_id);
+        else if(indexes.row == board.get_size() - 1)
+          another_side_cells.push_back(n_id);
+      }
+
+    }
+    
+    return is_win(board, one_side_cells, another_side_cells, out_win_path);
+  }
+  
+protected:
+
+  // breadth first search over stones of color from one its edge, queue and marks are on the stack,
+  // blue connects left and right columns, red connects top and bottom rows
+  static bool connects_edges(const hex_board& board, Color color, vector<int>* out_win_path)
+  {
+    const auto size = board.get_size();
+    array<short, max_cell_count> queue;
+    array<short, max_cell_count> predecessor;
+    cell_set visited;
+    int head = 0, tail = 0;
+    for(int i = 0; i < size; ++i)
+    {
+      auto cell_index = color == Color::blue ? board.to_cell_index(0, i) : board.to_cell_index(i, 0);
+      if(board.get_cell(cell_index).color != color)
+        continue;
+      visited.set(cell_index);
+      predecessor[cell_index] = -1;
+      queue[tail++] = static_cast<short>(cell_index);
+    }
+
+    while(head < tail)
+    {
+      int cell_index = queue[head++];
+      auto pos = board.to_position(cell_index);
+      if((color == Color::blue ? pos.column : pos.row) == size - 1)
+      {
+        if(out_win_path != nullptr)
+          for(int cell = cell_index; cell != -1; cell = predecessor[cell])
+            out_win_path->push_back(cell);
+        return true;
+      }
+      for(auto neighbor : board.get_neighbors(cell_index))
+      {
+        if(neighbor == -1 || visited.test(neighbor) || board.get_cell(neighbor).color != color)
+          continue;
+        visited.set(neighbor);
+        predecessor[neighbor] = static_cast<short>(cell_index);
+        queue[tail++] = neighbor;
+      }
+    }
+    return false;
+  }
+
+  static void reconstruct_path(int destination_cell, const unordered_map<int, int>& predecessor, vector<int>& out_path)
+  {
+    auto target = destination_cell;
+    out_path.push_back(target);
+
+    while (predecessor.count(target))
+    {
+      auto next_pred = predecessor.at(target);
+      out_path.push_back(next_pred);
+      target = next_pred;
+    }
+  }
+
+  static bool is_win(const hex_board& board, const vector<int>& one_side_cells, const vector<int>& another_side_cells, vector<int>* out_win_path = nullptr)
+  {
+    auto predecessor = out_win_path != nullptr ? optional<unordered_map<int, int>> {} : std::nullopt;
+    auto out_predecessor = predecessor.has_value() ? &predecessor.value() : nullptr;
+
+    // if has two cells on two sides
+    if(!one_side_cells.empty() && !another_side_cells.empty())
+    {
+      for(auto side_cell : one_side_cells)
+      {
+        for(auto another_side_cell : another_side_cells)
+        {
+          auto result = path_finder::search_path(board, side_cell, another_side_cell, out_predecessor);
+          if(result)
+          {
+            if(predecessor.has_value())
+              reconstruct_path(another_side_cell, predecessor.value(), (*out_win_path));
+            return result;
+          }
+        }
+      }
+    }
+    
+    return false;
+  }
+};
+
+class player_cpu : public base_player
+{
+public:
+  explicit player_cpu(Color color, unsigned int seed = time(nullptr))
+  : base_player(color)
+  , random(seed)
+  , opponent_connections(color == Color::blue ? Color::red : Color::blue)
+  { }
+
+  position make_move(const hex_board& board) override
+  {
+    // all arrays of move come from arena and member buffers, they allocate only when they grow past earlier moves
+    arena.reset();
+    const auto size = board.get_size();
+    const auto cell_count = size * size;
+    auto empty_cells = arena.allocate<short>(cell_count);
+    auto playout_cells = arena.allocate<short>(cell_count);
+    // score of move to cell, sum of +1 for won and -1 for lost playouts where player took the cell
+    auto scores = arena.allocate<int>(cell_count);
+    int empty_count = 0;
+    win_counts.assign(cell_count, 0);
+    taken_counts.assign(cell_count, 0);
+    for(int cell_index = 0; cell_index < cell_count; ++cell_index)
+    {
+      scores[cell_index] = 0;
+      if(board.get_cell(cell_index).color == Color::none)
+        empty_cells[empty_count++] = static_cast<short>(cell_index);
+    }
+    
+    // policy prior gives head start to likely moves, as if they already won some playouts
+    if(policy)
+    {
+      policy->move_priors(board, get_color(), priors);
+      auto max_prior = *std::max_element(priors.begin(), priors.end());
+      for(int i = 0; i < empty_count; ++i)
+        scores[empty_cells[i]] = static_cast<int>(std::lround(prior_playouts * priors[empty_cells[i]] / max_prior));
+      root_sampler.reset(board, *policy);
+    }
+
+    HexGameRules hex_rules;
+    auto start_time = std::chrono::steady_clock::now();
+    last_playout_count = 0;
+    for(unsigned int try_index = 0; try_index < monte_carlo_iteration_count; ++try_index, ++last_playout_count)
+    {
+      // clock is not free, check time budget on every 16 playouts
+      if(time_budget.count() > 0 && try_index % 16 == 15 && std::chrono::steady_clock::now() - start_time >= time_budget)
+        break;
+      playout_board.assign(board);
+      std::copy(empty_cells, empty_cells + empty_count, playout_cells);
+      auto remaining_count = empty_count;
+      auto next_player_color = this->get_color();
+      if(policy)
+        sampler.assign(root_sampler);
+      for(int j = 0; j < empty_count; ++j)
+      {
+        if(policy)
+        {
+          auto cell_index = sampler.sample(next_player_color, random);
+          playout_board.mark_cell(cell_index, next_player_color);
+          sampler.play(playout_board, cell_index);
+          next_player_color = next_player_color == Color::blue ? Color::red : Color::blue;
+          continue;
+        }
+
+        auto chosen_move_index = random() % remaining_count;
+        playout_board.mark_cell(playout_cells[chosen_move_index], next_player_color);
+        next_player_color = next_player_color == Color::blue ? Color::red : Color::blue;
+        
+        // fast erase, it changes order, but for this it's ok
+        playout_cells[chosen_move_index] = playout_cells[--remaining_count];
+      }
+      
+      //! if player win game add 1 or add -1 if not
+      int value = hex_rules.check_winner(playout_board) == this->get_color() ? 1 : -1;
+      
+      for(int i = 0; i < empty_count; ++i)
+      {
+        auto cell_index = empty_cells[i];
+        if(playout_board.get_cell(cell_index).color == this->get_color())
+        {
+          scores[cell_index] += value;
+          taken_counts[cell_index]++;
+          if(value > 0)
+            win_counts[cell_index]++;
+        }
+      }
+    }
+    
+    // counts are all moves as first statistics, so they go to cache as statistics of move, not of position.
+    // Cache gets only playouts of this run, and cached playouts of earlier runs join the scores only,
+    // at most as many as made now. Cached counts already include every earlier run,
+    // adding them back to cache would count old playouts again on every run
+    if(cache)
+    {
+      for(int i = 0; i < empty_count; ++i)
+      {
+        auto cell_index = empty_cells[i];
+        auto key = position_cache::make_move_key(board.get_canonical_hash_after(cell_index, get_color()), get_color());
+        auto cached = cache->find(key);
+        cache->add(key, static_cast<uint32_t>(taken_counts[cell_index]), static_cast<uint32_t>(win_counts[cell_index]));
+        if(!cached.has_value() || cached->visits == 0)
+          continue;
+        auto visits = std::min(cached->visits, last_playout_count);
+        auto wins = static_cast<int>(static_cast<uint64_t>(cached->wins) * visits / cached->visits);
+        scores[cell_index] += 2 * wins - static_cast<int>(visits);
+      }
+    }
+
+    // if opponent threatens to connect edges only moves inside of his connections can stop him
+    opponent_connections.update(board);
+    auto must_play = opponent_connections.must_play_region();
+    int best_cell = -1;
+    for(int pass = 0; pass < 2 && best_cell == -1; ++pass)
+    {
+      for(int i = 0; i < empty_count; ++i)
+      {
+        auto cell_index = empty_cells[i];
+        if(pass == 0 && must_play.has_value() && !must_play->test(cell_index))
+          continue;
+        if(best_cell == -1 || scores[cell_index] > scores[best_cell])
+          best_cell = cell_index;
+      }
+    }
+    return board.to_position(best_cell);
+  }
+
+  //! policy for playouts and move priors, uniform random playouts without it
+  void set_policy(std::shared_ptr<const pattern_policy> new_policy) { policy = std::move(new_policy); }
+  //! statistics of moves from earlier games, shared with other players and processes
+  void set_position_cache(std::shared_ptr<position_cache> new_cache) { cache = std::move(new_cache); }
+  //! for every cell count of won playouts where the cell was taken by player, from the last make_move
+  const vector<int>& get_win_counts() const { return win_counts; }
+  //! share of won playouts where the cell was taken by player, estimation of win probability after move to the cell
+  double get_move_value(int cell_index) const
+  {
+    return taken_counts[cell_index] > 0 ? static_cast<double>(win_counts[cell_index]) / taken_counts[cell_index] : 0.0;
+  }
+  unsigned int get_playout_count() const { return monte_carlo_iteration_count; }
+  void set_playout_count(unsigned int count) { monte_carlo_iteration_count = count; }
+  //! stop playouts when time is over even if playout count is not reached, zero for no time limit
+  void set_time_budget(std::chrono::milliseconds budget) { time_budget = budget; }
+  //! count of playouts made by the last make_move
+  unsigned int get_last_playout_count() const { return last_playout_count; }
+  
+private:
+  static constexpr int prior_playouts = 40;
+
+  minstd_rand random;
+  scratch_arena arena;
+  hex_board playout_board {1};
+  unsigned int monte_carlo_iteration_count = 2600;
+  unsigned int last_playout_count = 0;
+  std::chrono::milliseconds time_budget {0};
+  virtual_connections opponent_connections;
+  std::shared_ptr<const pattern_policy> policy;
+  std::shared_ptr<position_cache> cache;
+  vector<double> priors;
+  policy_sampler root_sampler;
+  policy_sampler sampler;
+  vector<int> win_counts;
+  vector<int> taken_counts;
+};
+
+// Monte Carlo tree search with progressive widening for big boards. Children of node are added one by one
+// in order of prior, node with n visits has at most widening_base + n^widening_exponent children, so search
+// goes deep into few promising moves instead of spreading playouts over all cells.
+// Prior comes from pattern policy when it is set, otherwise from connection distance of both colors through cell.
+// Playouts fill the board with random moves, full board always has one winner and the same winner
+// as when stones first connected, so tree does not check for end of game.
+// Every node also keeps all moves statistics (RAVE) like player_cpu, they lead search while visits are few,
+// root keeps them for every cell and widens in their order once it has playouts
+class player_mcts : public base_player
+{
+public:
+  explicit player_mcts(Color color, unsigned int seed = time(nullptr))
+  : base_player(color)
+  , random(seed)
+  , opponent_connections(color == Color::blue ? Color::red : Color::blue)
+  { }
+
+  position make_move(const hex_board& board) override
+  {
+    // node pool keeps its capacity, so after the first moves tree grows without allocation
+    nodes.clear();
+    nodes.push_back(tree_node {});
+    const auto cell_count = board.get_size() * board.get_size();
+    move_values.assign(cell_count, 0.0);
+    move_visits.assign(cell_count, 0);
+    root_visits.assign(cell_count, 0);
+    root_wins.assign(cell_count, 0);
+
+    // if opponent threatens to connect edges root gets only moves inside of his connections
+    opponent_connections.update(board);
+    root_region = opponent_connections.must_play_region();
+
+    auto start_time = std::chrono::steady_clock::now();
+    last_playout_count = 0;
+    for(unsigned int try_index = 0; try_index < playout_count; ++try_index, ++last_playout_count)
+    {
+      if(time_budget.count() > 0 && try_index % 16 == 15 && std::chrono::steady_clock::now() - start_time >= time_budget)
+        break;
+      run_playout(board);
+    }
+
+    int best_child = -1;
+    for(auto child = nodes[0].first_child; child != -1; child = nodes[child].next_sibling)
+    {
+      move_values[nodes[child].move] = static_cast<double>(nodes[child].wins) / std::max(nodes[child].visits, 1u);
+      move_visits[nodes[child].move] = nodes[child].visits;
+      if(best_child == -1 || nodes[child].visits > nodes[best_child].visits)
+        best_child = child;
+    }
+    assert(best_child != -1);
+    return board.to_position(nodes[best_child].move);
+  }
+
+  //! pattern policy for order of moves, connection distance order without it
+  void set_policy(std::shared_ptr<const pattern_policy> new_policy) { policy = std::move(new_policy); }
+  //! share of won playouts after move to the cell from the last make_move, 0 for moves that search did not try
+  double get_move_value(int cell_index) const { return move_values[cell_index]; }
+  //! for every cell visits of root child of the move from the last make_move, 0 for moves that search did not try
+  const vector<uint32_t>& get_move_visits() const { return move_visits; }
+  unsigned int get_playout_count() const { return playout_count; }
+  void set_playout_count(unsigned int count) { playout_count = count; }
+  //! stop playouts when time is over even if playout count is not reached, zero for no time limit
+  void set_time_budget(std::chrono::milliseconds budget) { time_budget = budget; }
+  //! count of playouts made by the last make_move
+  unsigned int get_last_playout_count() const { return last_playout_count; }
+  //! count of tree nodes made by the last make_move
+  size_t get_last_node_count() const { return nodes.size(); }
+
+private:
+  // 32 bytes, children are linked list in pool, so node does not own memory
+  struct tree_node
+  {
+    int first_child = -1;
+    int next_sibling = -1;
+    uint32_t visits = 0;
+    //! won playouts of color that made move to the node
+    uint32_t wins = 0;
+    //! playouts through parent where the same color took the cell of move later
+    uint32_t all_moves_visits = 0;
+    uint32_t all_moves_wins = 0;
+    short move = -1;
+    uint16_t child_count = 0;
+    //! all legal moves of node are children
+    bool expanded = false;
+  };
+
+  static constexpr double widening_base = 2.0;
+  static constexpr double widening_exponent = 0.4;
+  static constexpr double exploration = 0.2;
+  //! visits of node where its own statistics and all moves statistics have the same weight
+  static constexpr double all_moves_equivalence = 1000.0;
+
+  static Color opponent(Color color) { return color == Color::blue ? Color::red : Color::blue; }
+
+  // selection and widening down the tree, random playout from new leaf and update of statistics on the path
+  void run_playout(const hex_board& board)
+  {
+    search_board.assign(board);
+    path.clear();
+    path.push_back(0);
+    auto color = get_color();
+    int node = 0;
+    while(node == 0 || nodes[node].visits > 0)
+    {
+      widen(node, color);
+      if(nodes[node].first_child == -1)
+        break;
+      node = select_child(node);
+      search_board.mark_cell(nodes[node].move, color);
+      color = opponent(color);
+      path.push_back(node);
+    }
+
+    const auto cell_count = search_board.get_size() * search_board.get_size();
+    int remaining_count = 0;
+    playout_cells.resize(cell_count);
+    for(int cell_index = 0; cell_index < cell_count; ++cell_index)
+      if(search_board.get_cell(cell_index).color == Color::none)
+        playout_cells[remaining_count++] = static_cast<short>(cell_index);
+    while(remaining_count > 0)
+    {
+      auto chosen = random() % remaining_count;
+      search_board.mark_cell(playout_cells[chosen], color);
+      color = opponent(color);
+      playout_cells[chosen] = playout_cells[--remaining_count];
+    }
+
+    auto winner = rules.check_winner(search_board);
+    const auto player_won = winner == get_color();
+    for(int cell_index = 0; cell_index < cell_count; ++cell_index)
+    {
+      if(board.get_cell(cell_index).color != Color::none || search_board.get_cell(cell_index).color != get_color())
+        continue;
+      root_visits[cell_index]++;
+      if(player_won)
+        root_wins[cell_index]++;
+    }
+    // player moves into nodes of odd depth, opponent into nodes of even depth
+    auto mover = opponent(get_color());
+    for(auto path_node : path)
+    {
+      nodes[path_node].visits++;
+      if(mover == winner)
+        nodes[path_node].wins++;
+      mover = opponent(mover);
+
+      // cells of children were empty in the node, so on full board color of cell is the color that took it later
+      for(auto child = nodes[path_node].first_child; child != -1; child = nodes[child].next_sibling)
+      {
+        if(search_board.get_cell(nodes[child].move).color != mover)
+          continue;
+        nodes[child].all_moves_visits++;
+        if(mover == winner)
+          nodes[child].all_moves_wins++;
+      }
+    }
+  }
+
+  // adds the best by prior moves which are not children yet, as many as visits of node allow,
+  // priors of node are computed once for all new children
+  void widen(int node, Color color)
+  {
+    const auto allowed_count = static_cast<int>(std::ceil(widening_base + std::pow(nodes[node].visits, widening_exponent)));
+    if(nodes[node].expanded || nodes[node].child_count >= allowed_count)
+      return;
+
+    children.reset();
+    for(auto child = nodes[node].first_child; child != -1; child = nodes[child].next_sibling)
+      children.set(nodes[child].move);
+
+    if(!policy)
+    {
+      own_distance.connection_distance(search_board, color);
+      opponent_distance.connection_distance(search_board, opponent(color));
+    }
+
+    const auto cell_count = search_board.get_size() * search_board.get_size();
+    candidate_count = 0;
+    candidates.resize(cell_count);
+    for(int cell_index = 0; cell_index < cell_count; ++cell_index)
+    {
+      if(search_board.get_cell(cell_index).color != Color::none || children.test(cell_index))
+        continue;
+      if(node == 0 && root_region.has_value() && !root_region->test(cell_index))
+        continue;
+      double prior;
+      if(node == 0 && nodes[0].visits > 0)
+        prior = root_visits[cell_index] > 0 ? static_cast<double>(root_wins[cell_index]) / root_visits[cell_index] : 0.0;
+      else
+        prior = policy ? policy->move_weight(search_board, cell_index, color) : distance_prior(cell_index);
+      candidates[candidate_count++] = {prior, cell_index};
+    }
+
+    auto new_count = std::min(allowed_count - nodes[node].child_count, candidate_count);
+    std::partial_sort(candidates.begin(), candidates.begin() + new_count, candidates.begin() + candidate_count,
+                      [](const auto& left, const auto& right) { return left.first > right.first; });
+    // the worst new child first in list, the best prior is tried first among new children
+    for(int i = new_count - 1; i >= 0; --i)
+    {
+      tree_node child;
+      child.move = static_cast<short>(candidates[i].second);
+      child.next_sibling = nodes[node].first_child;
+      nodes[node].first_child = static_cast<int>(nodes.size());
+      nodes[node].child_count++;
+      nodes.push_back(child);
+    }
+    if(new_count == candidate_count)
+      nodes[node].expanded = true;
+  }
+
+  // cells on short paths of both colors first, paths through the cell cost fewer stones is the better move,
+  // on open board many cells have the same distance and the one closer to center is better
+  double distance_prior(int cell_index) const
+  {
+    auto own = own_distance.get_cell_distance(search_board, cell_index);
+    auto other = opponent_distance.get_cell_distance(search_board, cell_index);
+    const int max_distance = 2 * max_board_size;
+    auto pos = search_board.to_position(cell_index);
+    auto center = (search_board.get_size() - 1) / 2;
+    int column_offset = pos.column - center, row_offset = pos.row - center;
+    auto center_distance = (std::abs(column_offset) + std::abs(row_offset) + std::abs(column_offset + row_offset)) / 2;
+    return -static_cast<double>((own == -1 ? max_distance : own) + (other == -1 ? max_distance : other))
+           - 0.01 * center_distance;
+  }
+
+  // UCB1 on mix of own and all moves win rates, weight of all moves part goes down with visits,
+  // new child is tried before others
+  int select_child(int node) const
+  {
+    auto log_visits = std::log(static_cast<double>(std::max(nodes[node].visits, 1u)));
+    int best_child = -1;
+    double best_value = 0.0;
+    for(auto child = nodes[node].first_child; child != -1; child = nodes[child].next_sibling)
+    {
+      const auto& child_node = nodes[child];
+      if(child_node.visits == 0)
+        return child;
+      auto win_rate = static_cast<double>(child_node.wins) / child_node.visits;
+      if(child_node.all_moves_visits > 0)
+      {
+        auto all_moves_rate = static_cast<double>(child_node.all_moves_wins) / child_node.all_moves_visits;
+        auto all_moves_weight = std::sqrt(all_moves_equivalence / (3.0 * child_node.visits + all_moves_equivalence));
+        win_rate = all_moves_weight * all_moves_rate + (1.0 - all_moves_weight) * win_rate;
+      }
+      auto value = win_rate + exploration * std::sqrt(log_visits / child_node.visits);
+      if(best_child == -1 || value > best_value)
+      {
+        best_child = child;
+        best_value = value;
+      }
+    }
+    return best_child;
+  }
+
+  minstd_rand random;
+  HexGameRules rules;
+  unsigned int playout_count = 2600;
+  unsigned int last_playout_count = 0;
+  std::chrono::milliseconds time_budget {0};
+  std::shared_ptr<const pattern_policy> policy;
+  virtual_connections opponent_connections;
+  optional<cell_set> root_region;
+  vector<tree_node> nodes;
+  vector<int> path;
+  vector<short> playout_cells;
+  vector<double> move_values;
+  vector<uint32_t> move_visits;
+  //! all moves statistics of root, playouts where player took the cell and won of them
+  vector<uint32_t> root_visits;
+  vector<uint32_t> root_wins;
+  //! prior and cell of moves that can become children in widen
+  vector<std::pair<double, int>> candidates;
+  int candidate_count = 0;
+  cell_set children;
+  hex_board search_board {1};
+  path_finder own_distance;
+  path_finder opponent_distance;
+};
+
+// Fast computer player, one ply search with static resistance evaluation.
+// Current of the circuit crowds into obtuse corners of the board, so evaluation alone opens in a corner,
+// value of move is evaluation after it less distance of the cell from saddle point of both circuits.
+class player_resistance : public base_player
+{
+public:
+  using base_player::base_player;
+
+  position make_move(const hex_board& board) override
+  {
+    evaluator.saddle_distance(board, saddle);
+    hex_board board_copy(board);
+    int best_cell = -1;
+    double best_value = -std::numeric_limits<double>::infinity();
+    const auto cell_count = board.get_size() * board.get_size();
+    for(int cell_index = 0; cell_index < cell_count; ++cell_index)
+    {
+      if(board.get_cell(cell_index).color != Color::none)
+        continue;
+
+      board_copy.mark_cell(cell_index, get_color());
+      auto value = evaluator.evaluate(board_copy, get_color()) - saddle_weight * saddle[cell_index];
+      board_copy.mark_cell(cell_index, Color::none);
+
+      if(value > best_value)
+      {
+        best_value = value;
+        best_cell = cell_index;
+      }
+    }
+
+    assert(best_cell != -1);
+    return board.to_position(best_cell);
+  }
+
+private:
+  // larger weight plays near saddle point even when evaluation sees better move
+  static constexpr double saddle_weight = 0.5;
+
+  resistance_evaluator evaluator;
+  vector<double> saddle;
+};
+
+// Fixed set of worker threads with work stealing: every worker has own queue, tasks submitted from outside
+// spread over queues by turn, tasks submitted from a worker go to its own queue, idle worker steals from others.
+// Task gets index of worker that runs it, so it can use own engine of the worker without locks
+class thread_pool
+{
+public:
+  explicit thread_pool(int thread_count)
+  {
+    for(int index = 0; index < thread_count; ++index)
+      queues.push_back(std::make_unique<worker_queue>());
+    for(int index = 0; index < thread_count; ++index)
+      workers.emplace_back([this, index] { work(index); });
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  //! waits until all submitted tasks are complete
+  ~thread_pool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      stopping = true;
+    }
+    has_task.notify_all();
+    for(auto& worker : workers)
+      worker.join();
+  }
+
+  int get_thread_count() const { return static_cast<int>(workers.size()); }
+
+  void submit(std::function<void(int)> task)
+  {
+    auto index = current_pool == this ? current_worker : static_cast<int>(next_queue++ % queues.size());
+    pending++;
+    {
+      std::lock_guard<std::mutex> lock(queues[index]->mutex);
+      queues[index]->tasks.push_back(std::move(task));
+    }
+    // empty lock makes sure that sleeping worker either sees the task or gets notification
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    has_task.notify_one();
+  }
+
+private:
+  struct worker_queue
+  {
+    std::mutex mutex;
+    std::deque<std::function<void(int)>> tasks;
+  };
+
+  void work(int index)
+  {
+    current_pool = this;
+    current_worker = index;
+    while(true)
+    {
+      std::function<void(int)> task;
+      if(pop_task(index, task))
+      {
+        task(index);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(sleep_mutex);
+      has_task.wait(lock, [this] { return stopping || pending > 0; });
+      if(stopping && pending == 0)
+        return;
+    }
+  }
+
+  // own queue from front, other queues from back, so owner and thief do not fight for the same tasks
+  bool pop_task(int index, std::function<void(int)>& out_task)
+  {
+    const auto queue_count = static_cast<int>(queues.size());
+    for(int offset = 0; offset < queue_count; ++offset)
+    {
+      auto& queue = *queues[(index + offset) % queue_count];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if(queue.tasks.empty())
+        continue;
+      if(offset == 0)
+      {
+        out_task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      }
+      else
+      {
+        out_task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      }
+      pending--;
+      return true;
+    }
+    return false;
+  }
+
+  static inline thread_local thread_pool* current_pool = nullptr;
+  static inline thread_local int current_worker = -1;
+
+  vector<std::unique_ptr<worker_queue>> queues;
+  std::atomic<size_t> pending{0};
+  std::atomic<size_t> next_queue{0};
+  std::mutex sleep_mutex;
+  std::condition_variable has_task;
+  bool stopping = false;
+  vector<std::thread> workers;
+};
+
+#endif //HEX_GAME_HEX_ENGINE_H
@@ -1,433 +1,14 @@
 /*
  * The hex game (or game of hex) https://en.wikipedia.org/wiki/Hex_(board_game)
  * Another implementation for terminal with C++17
- * For easy compilation all code placed in one file
+ * Engine placed in header only hex_engine.h, the same engine used by hex_analyze tool
+ * hex_game --watch shows game of computer with itself, board redrawn in place
  * used Monte Carlo for computer player AI
  *
  */
 
 
-#include <iostream>
-#include <iomanip>
-#include <string>
-#include <vector>
-#include <queue>
-#include <array>
-#include <unordered_map>
-#include <unordered_set>
-#include <utility>
-#include <algorithm>
-#include <random>
-#include <memory>
-#include <functional>
-#include <optional>
-// uncomment to disable assert()
-// #define NDEBUG
-#include <cassert>
-
-using std::vector;
-using std::pair;
-using std::cout;
-using std::cin;
-using std::array;
-using std::string;
-using std::minstd_rand;
-using std::priority_queue;
-using std::unordered_map;
-using std::unordered_set;
-using std::optional;
-
-enum class Color
-{
-  none,
-  red,
-  blue,
-};
-
-struct hex_cell
-{
-  Color color = Color::none;
-};
-
-struct position
-{
-  position(short column, short row)
-  : column(column)
-  , row(row) {}
-
-  short column = 0;
-  short row = 0;
-};
-
-class hex_board
-{
-  public:
-    explicit hex_board(int size);
-    void assign(const hex_board& other_board);
-    hex_cell get_cell(int column, int row) const;
-    hex_cell get_cell(int cell_index) const;
-    void mark_cell(int cell_index, Color color) { hex_cells[cell_index].color = color; }
-    void mark_cell(int column, int row, Color color)
-    { 
-      auto cell_index = to_cell_index(column, row);
-      hex_cells[cell_index].color = color;
-    }
-    bool is_valid_position(int column, int row) const;
-    int to_cell_index(int column, int row) const;
-    position to_position(int cell_index) const;
-    int get_size() const { return size; }
-    array<short, 6> get_neighbors(int cell_index) const;
-    //! draw with manipulator of output
-    void draw(optional<std::function<char(int)>> manipulator);
-  private:
-    [[nodiscard]] hex_cell create_cell(int column, int row) const;
-    void draw_line(int padding, char symbol) const;
-  
-    vector<hex_cell> hex_cells;
-    int size;
-};
-
-hex_board::hex_board(int size)
-: hex_cells(size*size)
-, size(size)
-{
-  int index = 0;
-  for(int row = 0; row < size; ++row)
-  {
-    for(int column = 0; column < size; ++column)
-    {
-      auto cell = create_cell(column, row);
-      hex_cells[index] = cell;
-      index++;
-    }
-  }
-}
-
-void hex_board::assign(const hex_board& other_board)
-{
-  hex_cells.assign(other_board.hex_cells.begin(), other_board.hex_cells.end());
-  size = other_board.size;
-}
-
-bool hex_board::is_valid_position(int column, int row) const
-{
-  return row >= 0 && row < size && column >= 0 && column < size;
-}
-
-hex_cell hex_board::get_cell(int column, int row) const
-{
-  auto index = to_cell_index(column, row);
-  return get_cell(index);
-}
-
-hex_cell hex_board::get_cell(int cell_index) const
-{
-  assert(cell_index >= 0 && (size_t)cell_index < hex_cells.size());
-  return hex_cells[cell_index];
-}
-
-int hex_board::to_cell_index(int column, int row) const
-{
-  if(!is_valid_position(column, row))
-    return -1;
-  return row * size + column;
-}
-
-position hex_board::to_position(int cell_index) const
-{
-  short column = cell_index % size;
-  short row = cell_index / size;
-  position result {column, row};
-  return result;
-}
-
-array<short, 6> hex_board::get_neighbors(int cell_index) const
-{
-  auto index = to_position(cell_index);
-  int column = index.column, row = index.row;
-  short left = to_cell_index(column - 1, row);
-  short right = to_cell_index(column + 1, row);
-  short top_left = to_cell_index(column, row - 1);
-  short top_right = to_cell_index(column + 1, row - 1);
-  short bottom_left = to_cell_index(column - 1, row + 1);
-  short bottom_right = to_cell_index(column, row + 1);
-  return array<short, 6> {top_left, top_right, left, right, bottom_left, bottom_right };
-}
-
-hex_cell hex_board::create_cell(int column, int row) const
-{
-  assert(is_valid_position(column, row));
-  return hex_cell();
-}
-
-void hex_board::draw_line(int padding, char symbol) const
-{
-  std::ios oldState(nullptr);
-  oldState.copyfmt(std::cout);
-  
-  cout<<std::setw(padding);
-  for(int i = 0; i < size; ++i)
-    cout<<std::hex<<i<<' ';
-  cout<<'\n';
-
-  cout<<std::setw(padding);
-  for(int i = 0; i < size; ++i)
-    cout << symbol << ' ';
-  cout<<'\n';
-  
-  std::cout.copyfmt(oldState);
-}
-
-void hex_board::draw(optional<std::function<char(int)>> manipulator = std::nullopt)
-{
-  const int padding = 5;
-  draw_line(padding+4, 'R');
-  
-  // save params of output, and restore them later
-  std::ios oldState(nullptr);
-  oldState.copyfmt(std::cout);
-  
-  for(int i = 0, index = 0; i < size; ++i)
-  {
-    cout<<std::setw(padding+i);
-    cout<<std::hex<<i;
-    cout<<" B ";
-    for(int j = 0; j < size; ++j, index++)
-    {
-      auto value = hex_cells[index].color;
-      
-      // if manipulator return '\0' (zero), that's shows no need to modify output
-      auto symbol = manipulator.has_value() ? manipulator.value()(index) : '\0';
-      if(symbol == '\0')
-      {
-        if(value == Color::red)
-          cout<<'R';
-        else if(value == Color::blue)
-          cout<<'B';
-        else
-          cout<<'.';
-      }
-      else
-      {
-        cout<<symbol;
-      }
-      
-      if(j != size-1)
-        cout<<"-";
-    }
-    
-    cout<<" B ";
-    cout<<std::hex<<i;
-    
-    if(i != size-1)
-    {
-      cout<<'\n';
-      cout<<std::setw(padding+5+i);
-      for(int j = 0; j < size+size-1; ++j)
-      {
-        if(j % 2 == 0)
-          cout<<"\\";
-        else
-          cout<<"/";
-      }
-    }
-    
-    cout<<'\n';
-  }
-  // restore output params
-  std::cout.copyfmt(oldState);
-  
-  draw_line(padding+4+size-1, 'R');
-  
-  cout<<"\n\n"<<std::endl;
-}
-
-class path_finder
-{
-public:
-    static bool search_path(const hex_board& board, const int cell_from, const int cell_to, unordered_map<int, int>* out_predecessor = nullptr)
-    {
-      // priority queue by path cost
-      auto cmp = [](cell_cost left, cell_cost right) { return left.cost > right.cost; };
-      priority_queue<cell_cost, std::vector<cell_cost>, decltype(cmp)> open_set(cmp);
-      
-      // for reconstruct path, "predecessor[B] = A" records A as the predecessor of B, meaning that A discovered B.
-      auto predecessor = out_predecessor;
-      // initial value
-      open_set.push(cell_cost{cell_from, 0});
-      
-      unordered_set<int> closed_set;
-      
-      while(!open_set.empty())
-      {
-        auto next = open_set.top();
-        open_set.pop();
-        
-        auto cell = next.cell;
-        int cost = next.cost;
-        
-        closed_set.insert(cell);
-        // stop search if found destination cell
-        if(cell == cell_to)
-          return true;
-        
-        auto neighbors = board.get_neighbors(cell);
-        for(auto neighbor : neighbors)
-        {
-          if(neighbor != -1)
-          {
-            auto new_cell = neighbor;
-            if(board.get_cell(new_cell).color != board.get_cell(cell_from).color)
-              continue;
-            // if in closed set go to next neighbor 
-            if(closed_set.count(new_cell) > 0)
-              continue;
-            // if have optionally param predecessor, write to it
-            if(predecessor != nullptr && (*predecessor).count(new_cell) == 0)
-              (*predecessor)[new_cell] = cell;
-            // all cost growing by 1
-            open_set.push(cell_cost{new_cell, cost+1});
-          }
-        }
-      }
-      
-      return false;
-    }
-    
-private:
-  struct cell_cost
-  {
-    int cell;
-    int cost;
-  };
-};
-
-// Abstract player base class for hex game player
-class base_player
-{
-  public:
-    explicit base_player(Color color)
-    : color(color) {}
-    
-    Color get_color() const { return color; }
-    void capture_cell(int cell_index) { captured_cells.push_back(cell_index); }
-    const vector<int>& get_captured_cells() const { return captured_cells; }
-
-    virtual position make_move(const hex_board& board) = 0;
-    
-  private:
-    Color color;
-    vector<int> captured_cells;
-};
-
-// Game rules for determine win and get path that player build
-class HexGameRules
-{
-public:
-
-  Color check_winner(const hex_board& board, vector<int>* out_win_path = nullptr)
-  {
-    vector<int> one_side_cells;
-    vector<int> another_side_cells;
-    for(int i = 0; i < board.get_size(); ++i)
-    {
-      if(board.get_cell(0, i).color == Color::blue)
-        one_side_cells.push_back(board.to_cell_index(0, i));
-      if(board.get_cell(board.get_size()-1, i).color == Color::blue)
-        another_side_cells.push_back(board.to_cell_index(board.get_size() - 1, i));
-    }
-    
-    if(is_win(board, one_side_cells, another_side_cells, out_win_path))
-      return Color::blue;
-    
-    one_side_cells.clear();
-    another_side_cells.clear();
-    for(int i = 0; i < board.get_size(); ++i)
-    {
-      if(board.get_cell(i, 0).color == Color::red)
-        one_side_cells.push_back(board.to_cell_index(0, i));
-      if(board.get_cell(i, board.get_size()-1).color == Color::red)
-        another_side_cells.push_back(board.to_cell_index(i, board.get_size() - 1));
-    }
-    
-    if(is_win(board, one_side_cells, another_side_cells, out_win_path))
-      return Color::red;
-    
-    return Color::none;
-  }
-
-  bool is_winner(const hex_board& board, const base_player& player, vector<int>* out_win_path = nullptr)
-  {
-    // first get all hex cells on the player win side
-    auto captured_cells = player.get_captured_cells();
-    vector<int> one_side_cells;
-    vector<int> another_side_cells;
-    for(auto n_id : captured_cells)
-    {
-      auto indexes = board.to_position(n_id);
-      // get all blue cells on destination side from start to end
-      if(player.get_color() == Color::blue)
-      {
-        if(indexes.column == 0)
-          one_side_cells.push_back(n_id);
-        else if(indexes.column == board.get_size() - 1)
-          another_side_cells.push_back(n_id);
-      }
-      // get all red cells on destination side from start to end
-      else
-      {
-        if(indexes.row == 0)
-          one_side_cells.push_back(n_id);
-        else if(indexes.row == board.get_size() - 1)
-          another_side_cells.push_back(n_id);
-      }
-
-    }
-    
-    return is_win(board, one_side_cells, another_side_cells, out_win_path);
-  }
-  
-protected:
-
-  static void reconstruct_path(int destination_cell, const unordered_map<int, int>& predecessor, vector<int>& out_path)
-  {
-    auto target = destination_cell;
-    out_path.push_back(target);
-
-    while (predecessor.count(target))
-    {
-      auto next_pred = predecessor.at(target);
-      out_path.push_back(next_pred);
-      target = next_pred;
-    }
-  }
-
-  static bool is_win(const hex_board& board, const vector<int>& one_side_cells, const vector<int>& another_side_cells, vector<int>* out_win_path = nullptr)
-  {
-    auto predecessor = out_win_path != nullptr ? optional<unordered_map<int, int>> {} : std::nullopt;
-    auto out_predecessor = predecessor.has_value() ? &predecessor.value() : nullptr;
-
-    // if has two cells on two sides
-    if(!one_side_cells.empty() && !another_side_cells.empty())
-    {
-      for(auto side_cell : one_side_cells)
-      {
-        for(auto another_side_cell : another_side_cells)
-        {
-          auto result = path_finder::search_path(board, side_cell, another_side_cell, out_predecessor);
-          if(result)
-          {
-            if(predecessor.has_value())
-              reconstruct_path(another_side_cell, predecessor.value(), (*out_win_path));
-            return result;
-          }
-        }
-      }
-    }
-    
-    return false;
-  }
-};
+#include "hex_engine.h"
 
 class player_human : public base_player
 {
@@ -447,98 +28,29 @@ public:
   }
 };
 
-class player_cpu : public base_player
-{
-public:
-  explicit player_cpu(Color color)
-  : base_player(color)
-  , random(time(nullptr))
-  { }
-
-  position make_move(const hex_board& board) override
-  {
-    vector<position> valid_cells;
-    unordered_map<int, int> win_table;
-
-    const auto size = board.get_size();
-    for(int row = 0; row < size; ++row)
-    {
-      for(int column = 0; column < size; ++column)
-      {
-        auto index = board.to_cell_index(column, row);
-        if(board.get_cell(index).color != Color::none)
-          continue;
-
-        valid_cells.emplace_back(column, row);
-        // win count set to 0
-        win_table[index] = 0;
-      }
-    }
-    
-    HexGameRules hex_rules;
-    hex_board board_copy(board);
-    auto valid_moves_count = valid_cells.size();
-    vector<position> valid_cells_copy;
-    valid_cells_copy.reserve(valid_moves_count);
-    for(unsigned int try_index = 0; try_index < monte_carlo_iteration_count; ++try_index)
-    {
-      board_copy.assign(board);
-      valid_cells_copy.assign(valid_cells.begin(), valid_cells.end());
-      auto next_player_color = this->get_color();
-      for(unsigned int j = 0; j < valid_moves_count; ++j)
-      {
-        auto chosen_move_index = random() % valid_cells_copy.size();
-        auto move_pos = valid_cells_copy[chosen_move_index];
-        board_copy.mark_cell(move_pos.column, move_pos.row, next_player_color);
-        next_player_color = next_player_color == Color::blue ? Color::red : Color::blue;
-        
-        // fast erase, it changes order, but for this it's ok
-        if(valid_cells_copy.size() > 1)
-          std::swap(valid_cells_copy.back(), valid_cells_copy[chosen_move_index]);
-        valid_cells_copy.pop_back();
-      }
-      
-      //! if player win game add 1 or add -1 if not
-      int value = hex_rules.check_winner(board_copy) == this->get_color() ? 1 : -1;
-      
-      for(auto pos : valid_cells)
-      {
-        auto cell_index = board.to_cell_index(pos.column, pos.row);
-        if(board_copy.get_cell(cell_index).color == this->get_color())
-          win_table[cell_index]+=value;
-      }
-    }
-    
-    auto result = std::max_element(win_table.begin(), win_table.end(), [] (const auto& lhs, const auto& rhs) { return lhs.second < rhs.second; } );
-    return board.to_position(result->first);
-  }
-  
-private:
-  minstd_rand random;
-  const unsigned int monte_carlo_iteration_count = 2600;
-};
-
 class hex_game : public HexGameRules
 {
   public:
-    explicit hex_game(int board_size)
+    explicit hex_game(int board_size, std::shared_ptr<const pattern_policy> policy = nullptr, std::shared_ptr<position_cache> cache = nullptr)
     : board(board_size)
     , player_blue(Color::blue)
     , player_red(Color::red)
     {
+      player_red.set_policy(std::move(policy));
+      player_red.set_position_cache(std::move(cache));
     }
     
     void run_loop()
     {
       while(true)
       {
-        board.draw();
+        renderer.draw(board);
 
         make_valid_move(player_blue);
         if(check_is_winner(player_blue, "Blue"))
           return;
         
-        board.draw();
+        renderer.draw(board);
 
         make_valid_move(player_red);
         if(check_is_winner(player_red, "Red"))
@@ -578,21 +90,10 @@ class hex_game : public HexGameRules
       vector<int> win_path;
       if(is_winner(board, player, &win_path))
       {
-        auto modify_win_path = [&](int cell_index)
-          {
-            auto find_result = std::find(win_path.begin(), win_path.end(), cell_index);
-            if(find_result != win_path.end())
-            {
-              auto color = board.get_cell(cell_index).color;
-              if(color == Color::blue)
-                return 'b';
-              else if(color == Color::red)
-                return 'r';
-            }
-            // do not modify output
-            return static_cast<char>(0);
-          };
-        board.draw(modify_win_path);
+        cell_set highlight;
+        for(auto cell_index : win_path)
+          highlight.set(cell_index);
+        renderer.draw(board, highlight);
         
         cout<<"\n***********************\n";
         cout<<"\n Player "<<name<<" is winner!\n\n";
@@ -605,13 +106,201 @@ class hex_game : public HexGameRules
       
 private:
   hex_board board;
+  board_renderer renderer;
   player_human player_blue;
   player_cpu player_red;
 };
 
-int main(int, char **)
-{  
-  hex_game game(11);
+// Computer plays with itself, board redrawn in place after every move
+void watch_game(int board_size, const std::shared_ptr<const pattern_policy>& policy)
+{
+  hex_board board(board_size);
+  board_renderer renderer(true);
+  HexGameRules rules;
+  player_cpu player_blue(Color::blue);
+  player_cpu player_red(Color::red);
+  player_blue.set_policy(policy);
+  player_red.set_policy(policy);
+
+  vector<int> win_path;
+  auto winner = Color::none;
+  for(int move = 0; winner == Color::none; ++move)
+  {
+    renderer.draw(board);
+    player_cpu& player = move % 2 == 0 ? player_blue : player_red;
+    auto pos = player.make_move(board);
+    board.mark_cell(pos.column, pos.row, player.get_color());
+    winner = rules.check_winner(board, &win_path);
+  }
+
+  cell_set highlight;
+  for(auto cell_index : win_path)
+    highlight.set(cell_index);
+  renderer.draw(board, highlight);
+  cout<<" Player "<<(winner == Color::blue ? "Blue" : "Red")<<" is winner!\n";
+}
+
+// Train pattern policy on games of resistance players, first moves are random to get different games
+bool train_pattern_policy(const string& path, int game_count, int board_size)
+{
+  const int random_move_count = 4;
+  pattern_trainer trainer;
+  HexGameRules rules;
+  minstd_rand random(time(nullptr));
+  for(int game = 0; game < game_count; ++game)
+  {
+    hex_board board(board_size);
+    player_resistance player_blue(Color::blue);
+    player_resistance player_red(Color::red);
+    for(int move = 0; rules.check_winner(board) == Color::none; ++move)
+    {
+      base_player& player = move % 2 == 0 ? static_cast<base_player&>(player_blue) : player_red;
+      int cell_index;
+      if(move < random_move_count)
+      {
+        do
+          cell_index = random() % (board_size * board_size);
+        while(board.get_cell(cell_index).color != Color::none);
+      }
+      else
+      {
+        auto pos = player.make_move(board);
+        cell_index = board.to_cell_index(pos.column, pos.row);
+        trainer.add_move(board, cell_index, player.get_color());
+      }
+      board.mark_cell(cell_index, player.get_color());
+    }
+    cout<<"Training game "<<game + 1<<" of "<<game_count<<" complete\n";
+  }
+  return trainer.build_policy().save(path);
+}
+
+// Games of tree search with itself, every position saved as training record with root visit distribution and game result,
+// moves of games appended to collection "<prefix>.hxgm"
+void self_play(const string& path_prefix, int game_count, int board_size, const std::shared_ptr<const pattern_policy>& policy)
+{
+  const size_t records_per_shard = 100000;
+  training_writer writer(path_prefix, records_per_shard);
+  HexGameRules rules;
+  for(int game = 0; game < game_count; ++game)
+  {
+    hex_board board(board_size);
+    player_mcts player_blue(Color::blue);
+    player_mcts player_red(Color::red);
+    player_blue.set_policy(policy);
+    player_red.set_policy(policy);
+
+    vector<training_record> records;
+    game_record moves_record;
+    moves_record.size = board_size;
+    moves_record.blue_player = moves_record.red_player = "hex_game mcts";
+    auto winner = Color::none;
+    for(int move = 0; winner == Color::none; ++move)
+    {
+      player_mcts& player = move % 2 == 0 ? player_blue : player_red;
+      auto pos = player.make_move(board);
+
+      training_record record;
+      record.size = board_size;
+      record.side_to_move = player.get_color();
+      for(int cell_index = 0; cell_index < board_size * board_size; ++cell_index)
+        record.cells.push_back(board.get_cell(cell_index).color);
+      const auto& visits = player.get_move_visits();
+      uint64_t visit_sum = 0;
+      for(auto count : visits)
+        visit_sum += count;
+      visit_sum = std::max<uint64_t>(visit_sum, 1);
+      for(auto count : visits)
+        record.policy.push_back(static_cast<uint8_t>(count * uint64_t(255) / visit_sum));
+      records.push_back(std::move(record));
+
+      board.mark_cell(pos.column, pos.row, player.get_color());
+      moves_record.moves.push_back(static_cast<short>(board.to_cell_index(pos.column, pos.row)));
+      winner = rules.check_winner(board);
+    }
+
+    moves_record.winner = winner;
+    if(!game_collection::append(path_prefix + ".hxgm", moves_record))
+      cout<<"Error! Can not save game to "<<path_prefix<<".hxgm\n";
+    for(auto& record : records)
+    {
+      record.result = record.side_to_move == winner ? 1 : -1;
+      writer.append(record);
+    }
+    cout<<"Self play game "<<game + 1<<" of "<<game_count<<" complete\n";
+  }
+
+  if(writer.get_dropped_count() > 0)
+    cout<<"Warning! "<<writer.get_dropped_count()<<" training records dropped\n";
+}
+
+// hex_game [--policy file] [--cache file] - play with computer, policy file makes its playouts smarter,
+// cache file keeps statistics of moves from earlier games
+// hex_game --train-policy file [games] - train policy on engine games and save to file
+// hex_game [--policy file] --self-play prefix [games] - write training data of computer games to shards
+// hex_game [--policy file] --watch - watch game of computer with itself
+// hex_game --export-sgf collection - print games of collection as SGF
+int main(int argc, char ** argv)
+{
+  const int board_size = 11;
+  std::shared_ptr<pattern_policy> policy;
+  std::shared_ptr<position_cache> cache;
+  for(int i = 1; i < argc; ++i)
+  {
+    string arg = argv[i];
+    if(arg == "--train-policy" && i + 1 < argc)
+    {
+      string path = argv[++i];
+      int game_count = i + 1 < argc ? std::stoi(argv[++i]) : 100;
+      return train_pattern_policy(path, game_count, board_size) ? 0 : 1;
+    }
+    else if(arg == "--self-play" && i + 1 < argc)
+    {
+      string path_prefix = argv[++i];
+      int game_count = i + 1 < argc ? std::stoi(argv[++i]) : 10;
+      self_play(path_prefix, game_count, board_size, policy);
+      return 0;
+    }
+    else if(arg == "--export-sgf" && i + 1 < argc)
+    {
+      game_collection collection;
+      if(!collection.open(argv[++i]))
+      {
+        cout<<"Error! Can not open game collection "<<argv[i]<<"\n";
+        return 1;
+      }
+      game_record game;
+      for(size_t index = 0; index < collection.size(); ++index)
+        if(collection.get(index, game))
+          cout<<game.to_sgf();
+      return 0;
+    }
+    else if(arg == "--watch")
+    {
+      watch_game(board_size, policy);
+      return 0;
+    }
+    else if(arg == "--policy" && i + 1 < argc)
+    {
+      policy = std::make_shared<pattern_policy>();
+      if(!policy->load(argv[++i]))
+      {
+        cout<<"Error! Can not load policy from "<<argv[i]<<"\n";
+        return 1;
+      }
+    }
+    else if(arg == "--cache" && i + 1 < argc)
+    {
+      cache = std::make_shared<position_cache>();
+      if(!cache->open(argv[++i]))
+      {
+        cout<<"Error! Can not open position cache "<<argv[i]<<"\n";
+        return 1;
+      }
+    }
+  }
+
+  hex_game game(board_size, policy, cache);
   game.run_loop();
   
   return 0;
@@ -0,0 +1,453 @@
+/*
+ * Server of hex games for many players at once, every client connection is one game with computer.
+ * Game session is a state machine driven by one event loop, so session waiting for human move costs no thread,
+ * computer moves run on shared work stealing pool with time budget of the game
+ *
+ * hex_server <socket path> [--threads N] [--budget milliseconds] [--policy file] [--cache file]
+ * cache file keeps playout statistics of moves between runs, several servers can share it
+ * --budget is default and also the largest budget client can ask for, so one game can not hold a worker for long
+ *
+ * Line protocol over Unix socket, coordinates are decimal column and row:
+ *   client: new <size> <blue|red> [budget]  - start game, human plays given color, blue moves first
+ *   client: move <column> <row>
+ *   client: board                            - get cells row by row as '.', 'R', 'B'
+ *   client: quit
+ *   server: ok | error <message> | move <column> <row> | winner <blue|red> | board <cells>
+ */
+
+#include "hex_engine.h"
+
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+enum class session_state
+{
+  waiting_new_game,
+  waiting_human_move,
+  cpu_thinking,
+  finished,
+};
+
+struct game_session
+{
+  uint64_t id = 0;
+  int descriptor = -1;
+  session_state state = session_state::waiting_new_game;
+  optional<hex_board> board;
+  Color human_color = Color::none;
+  std::chrono::milliseconds budget {0};
+  string input;
+  string output;
+  bool closing = false;
+};
+
+// Computer players of one worker thread, H-search and samplers are big, so they are not kept per game
+struct worker_engines
+{
+  worker_engines(unsigned int seed, const std::shared_ptr<const pattern_policy>& policy, const std::shared_ptr<position_cache>& cache)
+  : cpu_red(Color::red, seed)
+  , cpu_blue(Color::blue, seed + 1)
+  {
+    cpu_red.set_policy(policy);
+    cpu_blue.set_policy(policy);
+    cpu_red.set_position_cache(cache);
+    cpu_blue.set_position_cache(cache);
+    // time budget is the limit, playout count only protects from endless move
+    cpu_red.set_playout_count(std::numeric_limits<unsigned int>::max());
+    cpu_blue.set_playout_count(std::numeric_limits<unsigned int>::max());
+  }
+
+  player_cpu cpu_red;
+  player_cpu cpu_blue;
+};
+
+struct cpu_move
+{
+  uint64_t session_id;
+  int cell_index;
+};
+
+class game_server
+{
+public:
+  game_server(int listener, int thread_count, std::chrono::milliseconds default_budget,
+              const std::shared_ptr<const pattern_policy>& policy, const std::shared_ptr<position_cache>& cache)
+  : listener(listener)
+  , default_budget(default_budget)
+  {
+    for(int index = 0; index < thread_count; ++index)
+      engines.push_back(std::make_unique<worker_engines>(static_cast<unsigned int>(time(nullptr)) + index * 2, policy, cache));
+    if(pipe(wake_pipe) != 0)
+      wake_pipe[0] = wake_pipe[1] = -1;
+    else
+      set_non_blocking(wake_pipe[0]);
+    set_non_blocking(listener);
+    pool.emplace(thread_count);
+  }
+
+  ~game_server()
+  {
+    // finish running moves before engines and pipe are gone
+    pool.reset();
+    for(auto& [id, session] : sessions)
+      ::close(session.descriptor);
+    ::close(wake_pipe[0]);
+    ::close(wake_pipe[1]);
+  }
+
+  bool is_valid() const { return wake_pipe[0] != -1; }
+
+  void run()
+  {
+    vector<pollfd> descriptors;
+    vector<uint64_t> descriptor_sessions;
+    while(true)
+    {
+      descriptors.clear();
+      descriptor_sessions.clear();
+      // poll skips negative descriptor, listener rests while process is out of descriptors
+      descriptors.push_back(pollfd{accept_paused ? -1 : listener, POLLIN, 0});
+      descriptors.push_back(pollfd{wake_pipe[0], POLLIN, 0});
+      for(auto& [id, session] : sessions)
+      {
+        short events = POLLIN;
+        if(!session.output.empty())
+          events |= POLLOUT;
+        descriptors.push_back(pollfd{session.descriptor, events, 0});
+        descriptor_sessions.push_back(id);
+      }
+
+      auto ready = poll(descriptors.data(), descriptors.size(), accept_paused ? accept_retry_milliseconds : -1);
+      if(ready < 0)
+      {
+        if(errno == EINTR)
+          continue;
+        return;
+      }
+      // descriptors may be freed by other parts of the process too, so try again after a while
+      if(ready == 0)
+        accept_paused = false;
+
+      if(descriptors[0].revents & POLLIN)
+        accept_clients();
+      if(descriptors[1].revents & POLLIN)
+        apply_cpu_moves();
+
+      for(size_t i = 2; i < descriptors.size(); ++i)
+      {
+        auto it = sessions.find(descriptor_sessions[i - 2]);
+        if(it == sessions.end())
+          continue;
+        auto& session = it->second;
+        if(descriptors[i].revents & (POLLIN | POLLHUP | POLLERR))
+          read_client(session);
+        if(descriptors[i].revents & POLLOUT)
+          write_client(session);
+        if(session.closing && (session.output.empty() || (descriptors[i].revents & (POLLHUP | POLLERR))))
+        {
+          ::close(session.descriptor);
+          sessions.erase(it);
+          accept_paused = false;
+        }
+      }
+    }
+  }
+
+private:
+  static void set_non_blocking(int descriptor)
+  {
+    fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL, 0) | O_NONBLOCK);
+  }
+
+  void accept_clients()
+  {
+    while(true)
+    {
+      int descriptor = accept(listener, nullptr, nullptr);
+      if(descriptor < 0)
+      {
+        // interrupted by signal or client gave up before accept
+        if(errno == EINTR || errno == ECONNABORTED)
+          continue;
+        // pending connection stays in queue and keeps listener readable, polling it again would spin
+        if(errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+          accept_paused = true;
+        return;
+      }
+      set_non_blocking(descriptor);
+      auto id = next_session_id++;
+      auto& session = sessions[id];
+      session.id = id;
+      session.descriptor = descriptor;
+    }
+  }
+
+  void read_client(game_session& session)
+  {
+    char buffer[4096];
+    bool disconnected = false;
+    while(true)
+    {
+      auto count = ::read(session.descriptor, buffer, sizeof(buffer));
+      if(count > 0)
+      {
+        session.input.append(buffer, static_cast<size_t>(count));
+        continue;
+      }
+      disconnected = count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+      break;
+    }
+
+    size_t line_end;
+    while(!session.closing && (line_end = session.input.find('\n')) != string::npos)
+    {
+      auto line = session.input.substr(0, line_end);
+      session.input.erase(0, line_end + 1);
+      handle_line(session, line);
+    }
+    // protect from client that sends endless line
+    if(disconnected || session.input.size() > max_line_length)
+      session.closing = true;
+  }
+
+  void write_client(game_session& session)
+  {
+    while(!session.output.empty())
+    {
+      auto count = ::write(session.descriptor, session.output.data(), session.output.size());
+      if(count <= 0)
+      {
+        if(count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+          session.output.clear();
+          session.closing = true;
+        }
+        return;
+      }
+      session.output.erase(0, static_cast<size_t>(count));
+    }
+  }
+
+  void handle_line(game_session& session, const string& line)
+  {
+    std::istringstream stream(line);
+    string command;
+    stream >> command;
+
+    if(command == "quit")
+    {
+      session.closing = true;
+    }
+    else if(command == "board")
+    {
+      if(!session.board.has_value())
+      {
+        session.output += "error no game\n";
+        return;
+      }
+      session.output += "board ";
+      const auto& board = session.board.value();
+      for(int cell_index = 0; cell_index < board.get_size() * board.get_size(); ++cell_index)
+      {
+        auto color = board.get_cell(cell_index).color;
+        session.output += color == Color::red ? 'R' : color == Color::blue ? 'B' : '.';
+      }
+      session.output += '\n';
+    }
+    else if(command == "new")
+    {
+      int size = 0;
+      string color;
+      long budget = default_budget.count();
+      stream >> size >> color;
+      long game_budget;
+      if(stream >> game_budget)
+        budget = game_budget;
+      if(session.state == session_state::cpu_thinking)
+        session.output += "error computer is thinking\n";
+      else if(size < 2 || size > max_board_size || (color != "blue" && color != "red") || budget <= 0 || budget > default_budget.count())
+        session.output += "error usage: new <size> <blue|red> [budget]\n";
+      else
+      {
+        session.board.emplace(size);
+        session.human_color = color == "blue" ? Color::blue : Color::red;
+        session.budget = std::chrono::milliseconds(budget);
+        session.output += "ok\n";
+        session.state = session_state::waiting_human_move;
+        // blue moves first
+        if(session.human_color == Color::red)
+          start_cpu_move(session);
+      }
+    }
+    else if(command == "move")
+    {
+      int column = -1, row = -1;
+      stream >> column >> row;
+      if(session.state != session_state::waiting_human_move)
+        session.output += "error not your move\n";
+      else if(!session.board->is_valid_position(column, row) || session.board->get_cell(column, row).color != Color::none)
+        session.output += "error invalid move\n";
+      else
+      {
+        session.board->mark_cell(column, row, session.human_color);
+        session.output += "ok\n";
+        if(!check_winner(session))
+          start_cpu_move(session);
+      }
+    }
+    else
+      session.output += "error unknown command\n";
+  }
+
+  bool check_winner(game_session& session)
+  {
+    auto winner = rules.check_winner(session.board.value());
+    if(winner == Color::none)
+      return false;
+    session.output += winner == Color::blue ? "winner blue\n" : "winner red\n";
+    session.state = session_state::finished;
+    return true;
+  }
+
+  void start_cpu_move(game_session& session)
+  {
+    session.state = session_state::cpu_thinking;
+    auto cpu_color = session.human_color == Color::blue ? Color::red : Color::blue;
+    pool->submit([this, id = session.id, board = session.board.value(), cpu_color, budget = session.budget] (int worker)
+      {
+        auto& player = cpu_color == Color::red ? engines[worker]->cpu_red : engines[worker]->cpu_blue;
+        player.set_time_budget(budget);
+        auto move = player.make_move(board);
+        {
+          std::lock_guard<std::mutex> lock(completed_mutex);
+          completed.push_back(cpu_move{id, board.to_cell_index(move.column, move.row)});
+        }
+        // wake up event loop, pipe is never full for long, loop drains it
+        char signal = 1;
+        auto written = ::write(wake_pipe[1], &signal, 1);
+        (void)written;
+      });
+  }
+
+  void apply_cpu_moves()
+  {
+    char buffer[256];
+    while(::read(wake_pipe[0], buffer, sizeof(buffer)) > 0)
+      ;
+
+    vector<cpu_move> moves;
+    {
+      std::lock_guard<std::mutex> lock(completed_mutex);
+      std::swap(moves, completed);
+    }
+
+    for(auto move : moves)
+    {
+      // client could leave while computer was thinking
+      auto it = sessions.find(move.session_id);
+      if(it == sessions.end() || it->second.state != session_state::cpu_thinking)
+        continue;
+      auto& session = it->second;
+      auto cpu_color = session.human_color == Color::blue ? Color::red : Color::blue;
+      session.board->mark_cell(move.cell_index, cpu_color);
+      auto pos = session.board->to_position(move.cell_index);
+      session.output += "move " + std::to_string(pos.column) + " " + std::to_string(pos.row) + "\n";
+      if(!check_winner(session))
+        session.state = session_state::waiting_human_move;
+    }
+  }
+
+  static constexpr size_t max_line_length = 1024;
+  static constexpr int accept_retry_milliseconds = 1000;
+
+  int listener;
+  std::chrono::milliseconds default_budget;
+  int wake_pipe[2] = {-1, -1};
+  unordered_map<uint64_t, game_session> sessions;
+  uint64_t next_session_id = 1;
+  // accept failed for lack of descriptors, listener is not polled until a session closes
+  bool accept_paused = false;
+  HexGameRules rules;
+  std::mutex completed_mutex;
+  vector<cpu_move> completed;
+  vector<std::unique_ptr<worker_engines>> engines;
+  optional<thread_pool> pool;
+};
+
+int main(int argc, char** argv)
+{
+  if(argc < 2)
+  {
+    std::cerr<<"Usage: hex_server <socket path> [--threads N] [--budget milliseconds] [--policy file] [--cache file]\n";
+    return 1;
+  }
+
+  string socket_path = argv[1];
+  int thread_count = std::max(1u, std::thread::hardware_concurrency());
+  std::chrono::milliseconds budget {1000};
+  std::shared_ptr<pattern_policy> policy;
+  std::shared_ptr<position_cache> cache;
+  for(int i = 2; i < argc; ++i)
+  {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if(arg == "--threads" && has_value)
+      thread_count = std::max(1, std::stoi(argv[++i]));
+    else if(arg == "--budget" && has_value)
+      budget = std::chrono::milliseconds(std::stol(argv[++i]));
+    else if(arg == "--policy" && has_value)
+    {
+      policy = std::make_shared<pattern_policy>();
+      if(!policy->load(argv[++i]))
+      {
+        std::cerr<<"Error! Can not load policy from "<<argv[i]<<"\n";
+        return 1;
+      }
+    }
+    else if(arg == "--cache" && has_value)
+    {
+      cache = std::make_shared<position_cache>();
+      if(!cache->open(argv[++i]))
+      {
+        std::cerr<<"Error! Can not open position cache "<<argv[i]<<"\n";
+        return 1;
+      }
+    }
+  }
+
+  // disconnected client must not kill the server
+  std::signal(SIGPIPE, SIG_IGN);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address {};
+  address.sun_family = AF_UNIX;
+  if(listener < 0 || socket_path.size() >= sizeof(address.sun_path))
+  {
+    std::cerr<<"Error! Can not create socket "<<socket_path<<"\n";
+    return 1;
+  }
+  std::copy(socket_path.begin(), socket_path.end(), address.sun_path);
+  ::unlink(socket_path.c_str());
+  if(bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+  {
+    std::cerr<<"Error! Can not listen on "<<socket_path<<"\n";
+    return 1;
+  }
+
+  game_server server(listener, thread_count, budget, policy, cache);
+  if(!server.is_valid())
+  {
+    std::cerr<<"Error! Can not start server\n";
+    return 1;
+  }
+  server.run();
+  ::close(listener);
+  ::unlink(socket_path.c_str());
+
+  return 0;
+}